@@ -18,10 +18,15 @@
 */
 
 // Includes --------------------------------------------------------------------
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <list>
+#include <mutex>
 #include <string.h>
 #include <strings.h>
 #include "ColorMap.h"
+#include "ConstexprMath.h"
 
 // Local Macros ----------------------------------------------------------------
 enum ColorMapType
@@ -49,6 +54,28 @@ typedef struct
   ColorMap::ColorMapIndex index;
   const char  *str;
 } ColorMapIndexTable;
+typedef struct
+{
+  ColorMap::ColorMapIndex index;    // CMI_NOT_SPECIFIED for the mono map
+  unsigned int  colorNum;
+  unsigned int  multiNum;
+  double        gamma;
+  double        gain;
+  int           offset;
+} TableCacheKey;
+typedef struct
+{
+  TableCacheKey     key;
+  ColorMap::TablePtr table;
+} TableCacheEntry;
+struct SRGBTable
+{
+  // BIN_NUM is large enough that a bin never spans more than one 8bit value
+  // (the steepest slope is 12.92 * 255 per unit)
+  const static unsigned int BIN_NUM = 4096;
+  double          threshold[257];       // Smallest linear value for each 8bit value (+ sentinel)
+  unsigned char   binValue[BIN_NUM];    // 8bit value at the start of each bin
+};
 
 // Local static functions ------------------------------------------------------
 static void clearColorMap(unsigned int inColorNum,  unsigned char *outColorMap);
@@ -59,9 +86,17 @@ static double labSubInvFunc(double inT);
 static void getMultiColorMapData(ColorMap::ColorMapIndex inIndex,
           unsigned int inMultiNum, std::vector<ColorMapData> &outData);
 static const ColorMapData *getColorMapData(ColorMap::ColorMapIndex inIndex);
+static ColorMap::TablePtr getCachedTable(const TableCacheKey &inKey);
+static const SRGBTable &getSRGBTable();
+static inline unsigned char linToSRGB8(const SRGBTable &inTable, double inValue);
+static inline void convLabToLinRgbFast(const double *inLab, double *outRgbL);
+
+// Local static variables ------------------------------------------------------
+static std::mutex sTableCacheMutex;
+static std::list<TableCacheEntry> sTableCache;   // Most recently used first
 
 // Local static constants ------------------------------------------------------
-static const ColorMapData    kColorMapData[] =
+static constexpr ColorMapData  kColorMapData[] =
 {
   // GrayScale
   { ColorMap::CMI_GrayScale, 0.0, CMType_Linear, {0, 0, 0}},
@@ -154,6 +189,314 @@ const static ColorMapIndexTable  kColorMapIndexTable[] =
   { ColorMap::CMI_NOT_SPECIFIED, "" }
 };
 
+// Compile time tables ---------------------------------------------------------
+//  The default tables (DEFAULT_COLOR_NUM entries, multiNum = 1, gain = 1,
+//  offset = 0) of every ColorMapIndex and the mono maps of the common gamma
+//  values are generated at compile time. The functions below are constexpr
+//  copies of the runtime code path (getColorMap(), getMonoMap() and the
+//  original per-entry interpolateColor()) and must be kept in sync with it
+typedef ConstexprMath CM;
+struct DefaultColorMapTable
+{
+  unsigned char rgb[ColorMap::DEFAULT_COLOR_NUM * 3];
+};
+struct DefaultMonoMapTable
+{
+  double        gamma;
+  unsigned char value[ColorMap::DEFAULT_COLOR_NUM];
+};
+
+// -----------------------------------------------------------------------------
+// constConvRgbToMsh (constexpr version of convRgbToMsh(), D65 only)
+// -----------------------------------------------------------------------------
+static constexpr void constConvRgbToMsh(const unsigned char *inRgb, double *outMsh)
+{
+  const double  wpXyz[3] = {0.95047, 1.0, 1.08883};
+  double  rgbL[3] = {}, xyz[3] = {}, f[3] = {}, lab[3] = {};
+
+  for (int i = 0; i < 3; i++)
+  {
+    double  value = (double )inRgb[i] / 255.0;
+    if (value <= 0.040450)
+      value = value / 12.92;
+    else
+      value = CM::pow((value + 0.055) / 1.055, 2.4);
+    rgbL[i] = value;
+  }
+  xyz[0] = 0.412391 * rgbL[0] + 0.357584 * rgbL[1] +  0.180481 * rgbL[2];
+  xyz[1] = 0.212639 * rgbL[0] + 0.715169 * rgbL[1] +  0.072192 * rgbL[2];
+  xyz[2] = 0.019331 * rgbL[0] + 0.119195 * rgbL[1] +  0.950532 * rgbL[2];
+  for (int i = 0; i < 3; i++)
+  {
+    double  t = xyz[i] / wpXyz[i];
+    if (t > 0.008856)
+      f[i] = CM::pow(t, (1.0/3.0));
+    else
+      f[i] = 7.78703 * t + 16.0 / 116.0;
+  }
+  lab[0] = 116 *  f[1] - 16.0;
+  lab[1] = 500 * (f[0] - f[1]);
+  lab[2] = 200 * (f[1] - f[2]);
+  outMsh[0] = CM::sqrt(lab[0] * lab[0] + lab[1] * lab[1] + lab[2] * lab[2]);
+  outMsh[1] = CM::acos(lab[0] / outMsh[0]);
+  outMsh[2] = CM::atan2(lab[2], lab[1]);
+}
+
+// -----------------------------------------------------------------------------
+// constConvMshToRgb (constexpr version of convMshToRgb(), D65 only)
+// -----------------------------------------------------------------------------
+static constexpr void constConvMshToRgb(const double *inMsh, unsigned char *outRgb)
+{
+  const double  wpXyz[3] = {0.95047, 1.0, 1.08883};
+  double  lab[3] = {}, t[3] = {}, xyz[3] = {}, rgbL[3] = {};
+
+  lab[0] = inMsh[0] * CM::cos(inMsh[1]);
+  lab[1] = inMsh[0] * CM::sin(inMsh[1]) * CM::cos(inMsh[2]);
+  lab[2] = inMsh[0] * CM::sin(inMsh[1]) * CM::sin(inMsh[2]);
+  t[0] = (lab[0] + 16) / 116.0 + (lab[1] / 500.0);
+  t[1] = (lab[0] + 16) / 116.0;
+  t[2] = (lab[0] + 16) / 116.0 - (lab[2] / 200.0);
+  for (int i = 0; i < 3; i++)
+  {
+    if (t[i] > 0.20689)
+      xyz[i] = t[i] * t[i] * t[i] * wpXyz[i];
+    else
+      xyz[i] = (t[i] - 16.0 / 116.0) / 7.78703 * wpXyz[i];
+  }
+  rgbL[0] =  3.240970 * xyz[0] - 1.537383 * xyz[1] - 0.498611 * xyz[2];
+  rgbL[1] = -0.969244 * xyz[0] + 1.875968 * xyz[1] + 0.041555 * xyz[2];
+  rgbL[2] =  0.055630 * xyz[0] - 0.203977 * xyz[1] + 1.056972 * xyz[2];
+  for (int i = 0; i < 3; i++)
+  {
+    double  value = rgbL[i];
+    if (value <= 0.0031308)
+      value =  value * 12.92;
+    else
+      value = 1.055 * CM::pow(value, 1.0 / 2.4) - 0.055;
+    value = value * 255;
+    if (value < 0)
+      value = 0;
+    if (value > 255)
+      value = 255;
+    outRgb[i] = (unsigned char)value;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// constAdjustHue (constexpr version of adjustHue())
+// -----------------------------------------------------------------------------
+static constexpr double constAdjustHue(const double *inMsh, double inMunsat)
+{
+  if (inMsh[0] >= inMunsat)
+    return inMsh[2];
+
+  double  hSpin = inMsh[1] * CM::sqrt(inMunsat * inMunsat - inMsh[0] * inMsh[0]) /
+              (inMsh[0] * CM::sin(inMsh[1]));
+
+  if (inMsh[2] > -1.0472)
+    return inMsh[2] + hSpin;
+  return inMsh[2] - hSpin;
+}
+
+// -----------------------------------------------------------------------------
+// constInterpolateColor (constexpr version of interpolateColor())
+// -----------------------------------------------------------------------------
+//  inMsh0 and inMsh1 are the end points converted by constConvRgbToMsh()
+static constexpr void constInterpolateColor(const double *inMsh0, const double *inMsh1,
+                                            double inInterp, unsigned char *outRgb)
+{
+  double  msh0[3] = {inMsh0[0], inMsh0[1], inMsh0[2]};
+  double  msh1[3] = {inMsh1[0], inMsh1[1], inMsh1[2]};
+  double  msh[3] = {}, m = 0;
+
+  if ((msh0[1] > 0.05 && msh1[1] > 0.05) && CM::fabs(msh0[2] - msh1[2]) > 1.0472)
+  {
+    if (msh0[0] > msh1[0])
+      m = msh0[0];
+    else
+      m = msh1[0];
+    if (m < 88)
+      m = 88;
+    if (inInterp < 0.5)
+    {
+      msh1[0] = m;
+      msh1[1] = 0;
+      msh1[2] = 0;
+      inInterp = 2 * inInterp;
+    }
+    else
+    {
+      msh0[0] = m;
+      msh0[1] = 0;
+      msh0[2] = 0;
+      inInterp = 2 * inInterp - 1;
+    }
+  }
+
+  if (msh0[1] < 0.05 && msh1[1] > 0.05)
+    msh0[2] =  constAdjustHue(msh1, msh0[0]);
+  else if (msh0[1] > 0.05 && msh1[1] < 0.05)
+    msh1[2] =  constAdjustHue(msh0, msh1[0]);
+
+  for (int i = 0; i < 3; i++)
+    msh[i] = (1 - inInterp) * msh0[i] + inInterp * msh1[i];
+
+  constConvMshToRgb(msh, outRgb);
+}
+
+// -----------------------------------------------------------------------------
+// makeDefaultColorMapTable (constexpr version of getColorMap())
+// -----------------------------------------------------------------------------
+static constexpr DefaultColorMapTable makeDefaultColorMapTable(ColorMap::ColorMapIndex inIndex)
+{
+  const unsigned int  colorNum = ColorMap::DEFAULT_COLOR_NUM;
+  DefaultColorMapTable  table = {};
+  unsigned char *outColorMap = table.rgb;
+  unsigned int  index = 0, dataNum = 0, num = 0, numAll = 0, total = 0;
+
+  while (kColorMapData[index].index != inIndex)
+    index++;
+  while (kColorMapData[index + dataNum].index == inIndex)
+    dataNum++;
+  const ColorMapData  *colorMapData = &(kColorMapData[index]);
+  unsigned char rgb0[3] = {}, rgb1[3] = {};
+
+  // All the built-in maps start at 0.0 and end at 1.0
+  double  ratio0 = colorMapData[0].ratio, ratio1 = 0;
+  for (index = 0; index + 1 < dataNum; index++)
+  {
+    ratio1 = colorMapData[index + 1].ratio;
+    rgb0[0] = colorMapData[index].rgb.R;
+    rgb0[1] = colorMapData[index].rgb.G;
+    rgb0[2] = colorMapData[index].rgb.B;
+    rgb1[0] = colorMapData[index + 1].rgb.R;
+    rgb1[1] = colorMapData[index + 1].rgb.G;
+    rgb1[2] = colorMapData[index + 1].rgb.B;
+    if (ratio1 == 1.0)
+      numAll = colorNum - total;
+    else
+      numAll = (int )(ratio1 * colorNum)- (int )(ratio0 * colorNum);
+    num = numAll;
+    if (num > colorNum - total)
+      num = colorNum - total;
+
+    double  k = 1.0 / (double )(numAll - 1.0);
+    double  msh0[3] = {}, msh1[3] = {};
+    if (colorMapData[index].type == CMType_Diverging)
+    {
+      constConvRgbToMsh(rgb0, msh0);
+      constConvRgbToMsh(rgb1, msh1);
+    }
+    for (unsigned int i = 0; i < num; i++)
+    {
+      double  interp = (double )i * k;
+      if (colorMapData[index].type == CMType_Linear)
+      {
+        for (int j = 0; j < 3; j++)
+        {
+          double  v = (1.0 - interp) * rgb0[j] + interp * rgb1[j];
+          if (v > 255)
+            v = 255;
+          outColorMap[i * 3 + j] = (unsigned char)v;
+        }
+      }
+      else
+        constInterpolateColor(msh0, msh1, interp, &(outColorMap[i * 3]));
+    }
+    ratio0 = ratio1;
+    outColorMap += num * 3;
+    total += num;
+    if (total == colorNum)
+      break;
+  }
+  for (; total < colorNum; total++, outColorMap += 3)
+  {
+    outColorMap[0] = rgb1[0];
+    outColorMap[1] = rgb1[1];
+    outColorMap[2] = rgb1[2];
+  }
+  return table;
+}
+
+// -----------------------------------------------------------------------------
+// makeDefaultMonoMapTable (constexpr version of getMonoMap())
+// -----------------------------------------------------------------------------
+static constexpr DefaultMonoMapTable makeDefaultMonoMapTable(double inGamma)
+{
+  const unsigned int  colorNum = ColorMap::DEFAULT_COLOR_NUM;
+  DefaultMonoMapTable table = {};
+
+  table.gamma = inGamma;
+  double invGamma = 1.0 / inGamma;
+  for (unsigned int i = 0; i < colorNum; i++)
+  {
+    double v = (int )i * 1.0 / (double )(colorNum - 1.0);
+    if (v < 0.0)
+      v = 0.0;
+    if (v > 1.0)
+      v = 1.0;
+    v = CM::pow(v, invGamma);
+    v = v * 255.0;
+    if (v >= 255)
+      v = 255;
+    table.value[i] = (unsigned char)v;
+  }
+  return table;
+}
+
+// Each table is a separate constant expression to stay within the compiler's
+// constexpr evaluation limits
+static constexpr DefaultColorMapTable kGrayScaleTable = makeDefaultColorMapTable(ColorMap::CMI_GrayScale);
+static constexpr DefaultColorMapTable kJetTable = makeDefaultColorMapTable(ColorMap::CMI_Jet);
+static constexpr DefaultColorMapTable kRainbowTable = makeDefaultColorMapTable(ColorMap::CMI_Rainbow);
+static constexpr DefaultColorMapTable kRainbowWideTable = makeDefaultColorMapTable(ColorMap::CMI_RainbowWide);
+static constexpr DefaultColorMapTable kSpectrumTable = makeDefaultColorMapTable(ColorMap::CMI_Spectrum);
+static constexpr DefaultColorMapTable kSpectrumWideTable = makeDefaultColorMapTable(ColorMap::CMI_SpectrumWide);
+static constexpr DefaultColorMapTable kThermalTable = makeDefaultColorMapTable(ColorMap::CMI_Thermal);
+static constexpr DefaultColorMapTable kThermalWideTable = makeDefaultColorMapTable(ColorMap::CMI_ThermalWide);
+#ifndef BLEU_COLORMAP_USE_D50
+static constexpr DefaultColorMapTable kCoolWarmTable = makeDefaultColorMapTable(ColorMap::CMI_CoolWarm);
+static constexpr DefaultColorMapTable kPurpleOrangeTable = makeDefaultColorMapTable(ColorMap::CMI_PurpleOrange);
+static constexpr DefaultColorMapTable kGreenPurpleTable = makeDefaultColorMapTable(ColorMap::CMI_GreenPurple);
+static constexpr DefaultColorMapTable kBlueDarkYellowTable = makeDefaultColorMapTable(ColorMap::CMI_BlueDarkYellow);
+static constexpr DefaultColorMapTable kGreenRedTable = makeDefaultColorMapTable(ColorMap::CMI_GreenRed);
+#endif
+
+static const DefaultColorMapTable *const kDefaultColorMapTable[] =
+{
+  nullptr,    // CMI_NOT_SPECIFIED
+  &kGrayScaleTable,
+  &kJetTable,
+  &kRainbowTable,
+  &kRainbowWideTable,
+  &kSpectrumTable,
+  &kSpectrumWideTable,
+  &kThermalTable,
+  &kThermalWideTable,
+#ifndef BLEU_COLORMAP_USE_D50
+  &kCoolWarmTable,
+  &kPurpleOrangeTable,
+  &kGreenPurpleTable,
+  &kBlueDarkYellowTable,
+  &kGreenRedTable,
+#endif
+};
+
+static constexpr DefaultMonoMapTable  kDefaultMonoMapTable[] =
+{
+  makeDefaultMonoMapTable(1.0),
+  makeDefaultMonoMapTable(0.45),
+  makeDefaultMonoMapTable(0.5),
+  makeDefaultMonoMapTable(1.8),
+  makeDefaultMonoMapTable(2.0),
+  makeDefaultMonoMapTable(2.2),
+  makeDefaultMonoMapTable(2.4)
+};
+static const size_t kDefaultMonoMapTableNum =
+        sizeof(kDefaultMonoMapTable) / sizeof(kDefaultMonoMapTable[0]);
+static const size_t kDefaultColorMapTableNum =
+        sizeof(kDefaultColorMapTable) / sizeof(kDefaultColorMapTable[0]);
+
 // -----------------------------------------------------------------------------
 // getColorMap
 // -----------------------------------------------------------------------------
@@ -167,6 +510,14 @@ void ColorMap::getColorMap(ColorMapIndex inIndex, unsigned int inColorNum,
   double  ratio0, ratio1, offsetRatio;
   const unsigned char    *rgb0 = nullptr, *rgb1 = nullptr;
 
+  // Default parameters : copy the table generated at compile time
+  if (inColorNum == DEFAULT_COLOR_NUM && inMultiNum == 1 && inGain == 1.0 && inOffset == 0 &&
+      (unsigned int )inIndex < kDefaultColorMapTableNum && kDefaultColorMapTable[inIndex] != nullptr)
+  {
+    memcpy(outColorMap, kDefaultColorMapTable[inIndex]->rgb, sizeof(DefaultColorMapTable::rgb));
+    return;
+  }
+
   getMultiColorMapData(inIndex, inMultiNum, colorMapData);
   if (colorMapData.size() < 2 || inGain <= 0.0 || inColorNum == 0)
   {
@@ -182,6 +533,8 @@ void ColorMap::getColorMap(ColorMapIndex inIndex, unsigned int inColorNum,
   if (ratio0 > 0)
   {
     num = (int )((double )inColorNum * ratio0);
+    if (num > inColorNum)   // The map starts after the last entry
+      num = inColorNum;
     for (i = 0; i < num; i++)
     {
       outColorMap[0] = colorMapData[index].rgb.R;
@@ -261,11 +614,27 @@ void ColorMap::getMonoMap(int inColorNum,  unsigned char *outColorMap, double in
     return;
   }
 
-  double pitch = 1.0 / (double )(inColorNum - 1.0);
+  // Default parameters and a common gamma : expand the compile time table
+  if (inColorNum == (int )DEFAULT_COLOR_NUM && inGain == 1.0 && inOffset == 0)
+  {
+    for (size_t t = 0; t < kDefaultMonoMapTableNum; t++)
+    {
+      if (kDefaultMonoMapTable[t].gamma != inGamma)
+        continue;
+      const unsigned char *value = kDefaultMonoMapTable[t].value;
+      for (int i = 0; i < inColorNum; i++, outColorMap += 3)
+        outColorMap[0] = outColorMap[1] = outColorMap[2] = value[i];
+      return;
+    }
+  }
+
+  // Divide per entry (not multiply by 1 / (inColorNum - 1)) so that gamma = 1
+  // gives the exact ramp i * 255 / (inColorNum - 1)
+  double denom = (double )(inColorNum - 1.0);
   inGamma = 1.0 / inGamma;
   for (int i = 0; i < inColorNum; i++)
   {
-    double v = pitch * (i + inOffset) * inGain;
+    double v = (i + inOffset) * inGain / denom;
     if (v < 0.0)
       v = 0.0;
     if (v > 1.0)
@@ -281,6 +650,27 @@ void ColorMap::getMonoMap(int inColorNum,  unsigned char *outColorMap, double in
   }
 }
 
+// -----------------------------------------------------------------------------
+// getColorMapTable
+// -----------------------------------------------------------------------------
+ColorMap::TablePtr ColorMap::getColorMapTable(ColorMapIndex inIndex, unsigned int inColorNum,
+                                              unsigned int inMultiNum,
+                                              double inGain, int inOffset)
+{
+  TableCacheKey key = {inIndex, inColorNum, inMultiNum, 1.0, inGain, inOffset};
+  return getCachedTable(key);
+}
+
+// -----------------------------------------------------------------------------
+// getMonoMapTable
+// -----------------------------------------------------------------------------
+ColorMap::TablePtr ColorMap::getMonoMapTable(unsigned int inColorNum, double inGamma,
+                                             double inGain, int inOffset)
+{
+  TableCacheKey key = {CMI_NOT_SPECIFIED, inColorNum, 1, inGamma, inGain, inOffset};
+  return getCachedTable(key);
+}
+
 // -----------------------------------------------------------------------------
 // calcLinearColorMap
 // -----------------------------------------------------------------------------
@@ -314,16 +704,183 @@ void ColorMap::calcDivergingColorMap(const unsigned char *inRgb0, const unsigned
                                      unsigned int inOffset, unsigned int inColorNumAll,
                                      unsigned int inMapNum, unsigned char *outColorMap)
 {
+  double  msh0[3], msh1[3], lowerMsh[2][3], upperMsh[2][3];
   double  interp, k;
-  
+  bool    isSplit;
+
+  // Same as interpolateColor(), but the end points are converted (and
+  // adjusted) only once and each run of entries is evaluated in a batch
+  convRgbToMsh(inRgb0, msh0);
+  convRgbToMsh(inRgb1, msh1);
+  isSplit = getDivergingEndPoints(msh0, msh1, lowerMsh, upperMsh);
+
   k = 1.0 / (double )(inColorNumAll - 1.0);
-  for (unsigned int i = 0; i < inMapNum; i++)
+  unsigned int  i = 0;
+  while (i < inMapNum)
   {
     unsigned int t = i + inOffset;
     if (t >= inColorNumAll)   // Sanity check
+    {
       t = inColorNumAll - 1;
+      interp = (double )t * k;
+      interpolateColor(inRgb0, inRgb1, interp, &(outColorMap[i * 3]));
+      i++;
+      continue;
+    }
+
+    // Find the run of entries that uses the same end points. The split entry
+    // is estimated and then settled with the same test as the per entry one
     interp = (double )t * k;
-    interpolateColor(inRgb0, inRgb1, interp, &(outColorMap[i * 3]));
+    bool  isUpper = (isSplit && interp >= 0.5);
+    unsigned int  end = inColorNumAll;
+    if (isSplit && isUpper == false)
+    {
+      end = (unsigned int )(0.5 / k);
+      while (end > t + 1 && (double )(end - 1) * k >= 0.5)
+        end--;
+      while (end < inColorNumAll && (double )end * k < 0.5)
+        end++;
+      end = std::max(end, t + 1);
+    }
+    unsigned int  j = std::min(inMapNum, end - inOffset);
+
+    if (isSplit == false)
+      calcMshRamp(lowerMsh[0], lowerMsh[1], interp, k, j - i, &(outColorMap[i * 3]));
+    else if (isUpper == false)
+      calcMshRamp(lowerMsh[0], lowerMsh[1], 2 * interp, 2 * k, j - i, &(outColorMap[i * 3]));
+    else
+      calcMshRamp(upperMsh[0], upperMsh[1], 2 * interp - 1, 2 * k, j - i, &(outColorMap[i * 3]));
+    i = j;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// getDivergingEndPoints
+// -----------------------------------------------------------------------------
+bool ColorMap::getDivergingEndPoints(const double *inMsh0, const double *inMsh1,
+                                     double outLowerMsh[2][3], double outUpperMsh[2][3])
+{
+  double  m;
+  bool    isSplit = false;
+
+  for (int i = 0; i < 3; i++)
+  {
+    outLowerMsh[0][i] = outUpperMsh[0][i] = inMsh0[i];
+    outLowerMsh[1][i] = outUpperMsh[1][i] = inMsh1[i];
+  }
+
+  // Insert a neutral (white) mid point when both colors are saturated and far apart
+  if ((inMsh0[1] > 0.05 && inMsh1[1] > 0.05) && fabs(inMsh0[2] - inMsh1[2]) > 1.0472)
+  {
+    if (inMsh0[0] > inMsh1[0])
+      m = inMsh0[0];
+    else
+      m = inMsh1[0];
+    if (m < 88)
+      m = 88;
+    outLowerMsh[1][0] = m;
+    outLowerMsh[1][1] = 0;
+    outLowerMsh[1][2] = 0;
+    outUpperMsh[0][0] = m;
+    outUpperMsh[0][1] = 0;
+    outUpperMsh[0][2] = 0;
+    isSplit = true;
+  }
+
+  auto  adjust = [](double *ioMsh0, double *ioMsh1)
+  {
+    if (ioMsh0[1] < 0.05 && ioMsh1[1] > 0.05)
+      ioMsh0[2] =  adjustHue(ioMsh1, ioMsh0[0]);
+    else if (ioMsh0[1] > 0.05 && ioMsh1[1] < 0.05)
+      ioMsh1[2] =  adjustHue(ioMsh0, ioMsh1[0]);
+  };
+  adjust(outLowerMsh[0], outLowerMsh[1]);
+  if (isSplit)
+    adjust(outUpperMsh[0], outUpperMsh[1]);
+  return isSplit;
+}
+
+// -----------------------------------------------------------------------------
+// calcMshRamp
+// -----------------------------------------------------------------------------
+void ColorMap::calcMshRamp(const double *inMsh0, const double *inMsh1,
+                           double inInterp, double inInterpStep,
+                           unsigned int inNum, unsigned char *outColorMap)
+{
+  // The Msh -> linear RGB chain is evaluated at knots every kKnotStep entries
+  // and at the middle of each span, the entries in between are interpolated
+  // in linear RGB. The middle bounds the interpolation error of the span :
+  // a value closer than that to an 8bit threshold is evaluated exactly, so
+  // the result is the same as evaluating every entry
+  const unsigned int  kKnotStep = 32;
+  static_assert(kKnotStep <= 64, "The exact entries of a span are kept in a uint64_t");
+  const SRGBTable &table = getSRGBTable();
+  auto  evaluate = [&](double inIndex, double *outRgbL)
+  {
+    double  interp = inInterp + inInterpStep * inIndex;
+    double  msh[3], lab[3];
+    for (int c = 0; c < 3; c++)
+      msh[c] = inMsh0[c] + interp * (inMsh1[c] - inMsh0[c]);
+    convMshToLab(msh, lab);
+    convLabToLinRgbFast(lab, outRgbL);
+  };
+
+  double  rgb0[3], rgb1[3];
+  evaluate(0, rgb0);
+  for (unsigned int i = 0; i < inNum; i += kKnotStep)
+  {
+    unsigned int  num = inNum - i;
+    if (num > kKnotStep)
+      num = kKnotStep;
+
+    double  rgbMid[3], delta[3], margin[3];
+    evaluate(i + num, rgb1);
+    evaluate(i + num * 0.5, rgbMid);
+    for (int c = 0; c < 3; c++)
+    {
+      delta[c]  = (rgb1[c] - rgb0[c]) / num;
+      margin[c] = 2 * fabs(rgbMid[c] - (rgb0[c] + rgb1[c]) * 0.5) + 1e-9;
+    }
+    // A channel is linear over the span, so when both ends are safely inside
+    // the same 8bit bin the whole span is, otherwise it is checked per entry
+    uint64_t  exactMask = 0;
+    for (int c = 0; c < 3; c++)
+    {
+      auto  isSafe = [&](double inV, unsigned int inValue)
+      {
+        return (inValue == 0 || inV - margin[c] >= table.threshold[inValue]) &&
+                inV + margin[c] < table.threshold[inValue + 1];
+      };
+      double  vLast = rgb0[c] + delta[c] * (num - 1);
+      unsigned int  value = linToSRGB8(table, rgb0[c]);
+      if (value == linToSRGB8(table, vLast) &&
+          isSafe(rgb0[c], value) && isSafe(vLast, value))
+      {
+        for (unsigned int j = 0; j < num; j++)
+          outColorMap[j * 3 + c] = (unsigned char )value;
+        continue;
+      }
+      for (unsigned int j = 0; j < num; j++)
+      {
+        double  v = rgb0[c] + delta[c] * j;
+        value = linToSRGB8(table, v);
+        outColorMap[j * 3 + c] = (unsigned char )value;
+        if (!isSafe(v, value))
+          exactMask |= (uint64_t )1 << j;
+      }
+    }
+    for (unsigned int j = 0; exactMask != 0; j++, exactMask >>= 1)
+    {
+      if ((exactMask & 1) == 0)
+        continue;
+      double  rgbL[3];
+      evaluate(i + j, rgbL);
+      for (int c = 0; c < 3; c++)
+        outColorMap[j * 3 + c] = linToSRGB8(table, rgbL[c]);
+    }
+    outColorMap += num * 3;
+    for (int c = 0; c < 3; c++)
+      rgb0[c] = rgb1[c];
   }
 }
 
@@ -579,6 +1136,14 @@ void ColorMap::convLinRgbToRGB(const double *inRgbL, unsigned char *outRgb)
   }
 }
 
+// -----------------------------------------------------------------------------
+// convLinToSRGB8 (from linear sRGB to 8bit sRGB, table driven)
+// -----------------------------------------------------------------------------
+unsigned char ColorMap::convLinToSRGB8(double inValue)
+{
+  return linToSRGB8(getSRGBTable(), inValue);
+}
+
 // -----------------------------------------------------------------------------
 // stringToColorMapIndex
 // -----------------------------------------------------------------------------
@@ -659,7 +1224,7 @@ static double labSubFunc(double inT)
 static double labSubInvFunc(double inT)
 {
   if (inT > 0.20689)
-    return pow(inT, 3);
+    return inT * inT * inT;
   return (inT - 16.0 / 116.0) / 7.78703;
 }
 
@@ -709,3 +1274,140 @@ static const ColorMapData *getColorMapData(ColorMap::ColorMapIndex inIndex)
   
   return colorMapData;
 }
+
+// -----------------------------------------------------------------------------
+// getCachedTable
+// -----------------------------------------------------------------------------
+static ColorMap::TablePtr getCachedTable(const TableCacheKey &inKey)
+{
+  auto isSameKey = [&inKey](const TableCacheEntry &inEntry)
+  {
+    return inEntry.key.index == inKey.index && inEntry.key.colorNum == inKey.colorNum &&
+           inEntry.key.multiNum == inKey.multiNum && inEntry.key.gamma == inKey.gamma &&
+           inEntry.key.gain == inKey.gain && inEntry.key.offset == inKey.offset;
+  };
+
+  {
+    std::lock_guard<std::mutex> lock(sTableCacheMutex);
+    auto it = std::find_if(sTableCache.begin(), sTableCache.end(), isSameKey);
+    if (it != sTableCache.end())
+    {
+      sTableCache.splice(sTableCache.begin(), sTableCache, it);   // Mark as most recently used
+      return sTableCache.front().table;
+    }
+  }
+
+  // Build the table without holding the lock (this can take a while)
+  auto table = std::make_shared<std::vector<unsigned char>>((size_t )inKey.colorNum * 3);
+  if (inKey.index == ColorMap::CMI_NOT_SPECIFIED)
+    ColorMap::getMonoMap((int )inKey.colorNum, table->data(), inKey.gamma,
+                         inKey.gain, inKey.offset);
+  else
+    ColorMap::getColorMap(inKey.index, inKey.colorNum, table->data(), inKey.multiNum,
+                          inKey.gain, inKey.offset);
+
+  std::lock_guard<std::mutex> lock(sTableCacheMutex);
+  auto it = std::find_if(sTableCache.begin(), sTableCache.end(), isSameKey);
+  if (it != sTableCache.end())  // Another thread made the same table in the meantime
+  {
+    sTableCache.splice(sTableCache.begin(), sTableCache, it);
+    return sTableCache.front().table;
+  }
+  sTableCache.push_front({inKey, table});
+  while (sTableCache.size() > ColorMap::TABLE_CACHE_SIZE)
+    sTableCache.pop_back();   // Evict the least recently used table
+  return table;
+}
+
+// -----------------------------------------------------------------------------
+// getSRGBTable
+// -----------------------------------------------------------------------------
+static const SRGBTable &getSRGBTable()
+{
+  // threshold[v] is the smallest linear value that convLinRgbToRGB() maps to v,
+  // so the table gives exactly the same results as convLinRgbToRGB()
+  static const SRGBTable  sTable = []()
+  {
+    SRGBTable table;
+    auto convOne = [](double inValue)
+    {
+      double  rgbL[3] = {inValue, inValue, inValue};
+      unsigned char rgb[3];
+      ColorMap::convLinRgbToRGB(rgbL, rgb);
+      return (unsigned int )rgb[0];
+    };
+
+    table.threshold[0] = 0.0;
+    for (unsigned int v = 1; v < 256; v++)
+    {
+      // Bisection on the monotonic convLinRgbToRGB()
+      double  lo = table.threshold[v - 1], hi = 1.0;
+      while (true)
+      {
+        double  mid = lo + (hi - lo) / 2;
+        if (mid <= lo || mid >= hi)
+          break;
+        if (convOne(mid) >= v)
+          hi = mid;
+        else
+          lo = mid;
+      }
+      table.threshold[v] = hi;
+    }
+    table.threshold[256] = HUGE_VAL;
+
+    unsigned int  value = 0;
+    for (unsigned int i = 0; i < SRGBTable::BIN_NUM; i++)
+    {
+      double  binStart = (double )i / SRGBTable::BIN_NUM;
+      while (value < 255 && binStart >= table.threshold[value + 1])
+        value++;
+      table.binValue[i] = (unsigned char )value;
+    }
+    return table;
+  }();
+  return sTable;
+}
+
+// -----------------------------------------------------------------------------
+// linToSRGB8
+// -----------------------------------------------------------------------------
+static inline unsigned char linToSRGB8(const SRGBTable &inTable, double inValue)
+{
+  if (!(inValue > 0.0))   // also catches NaN
+    return 0;
+  unsigned int  bin = SRGBTable::BIN_NUM - 1;
+  if (inValue < 1.0)
+    bin = (unsigned int )(inValue * SRGBTable::BIN_NUM);
+  unsigned int  value = inTable.binValue[bin];
+  value += (inValue >= inTable.threshold[value + 1]);
+  return (unsigned char )value;
+}
+
+// -----------------------------------------------------------------------------
+// convLabToLinRgbFast
+// -----------------------------------------------------------------------------
+static inline void convLabToLinRgbFast(const double *inLab, double *outRgbL)
+{
+#ifdef BLEU_COLORMAP_USE_D50
+  double  xyz[3];
+  ColorMap::convLabToXyzD50(inLab, xyz);
+  ColorMap::convXyzD50ToLinRgb(xyz, outRgbL);
+#else
+  // Same as convLabToXyzD65() + convXyzToLinRgb() with the divisions replaced
+  // by multiplications and no branches the compiler can't convert
+  const double  *wpXyz = getD65WhitePointInXyz();
+  double  t[3], xyz[3];
+
+  t[1] = (inLab[0] + 16) * (1.0 / 116.0);
+  t[0] = t[1] + inLab[1] * (1.0 / 500.0);
+  t[2] = t[1] - inLab[2] * (1.0 / 200.0);
+  for (int i = 0; i < 3; i++)
+  {
+    double  cube = t[i] * t[i] * t[i];
+    double  linear = (t[i] - 16.0 / 116.0) * (1.0 / 7.78703);
+    xyz[i] = (t[i] > 0.20689 ? cube : linear) * wpXyz[i];
+  }
+  ColorMap::convXyzToLinRgb(xyz, outRgbL);
+#endif
+}
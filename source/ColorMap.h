@@ -22,6 +22,7 @@
 // Includes --------------------------------------------------------------------
 #include <vector>
 #include <string>
+#include <memory>
 
 // -----------------------------------------------------------------------------
 // ColorMap class
@@ -57,6 +58,12 @@ public:
     CMI_End         = -1
   };
 
+  const static size_t TABLE_CACHE_SIZE = 16;
+  const static unsigned int DEFAULT_COLOR_NUM = 256;
+
+  // Typedefs ------------------------------------------------------------------
+  typedef std::shared_ptr<const std::vector<unsigned char>>  TablePtr;  // RGB x colorNum
+
   // Static Functions ----------------------------------------------------------
   static void getColorMap(ColorMapIndex inIndex, unsigned int inColorNum,
                           unsigned char *outColorMap,
@@ -64,12 +71,22 @@ public:
                            double inGain = 1.0, int inOffset = 0);
   static void getMonoMap(int inColorNum,  unsigned char *outColorMap, double inGamma = 1.0,
                           double inGain = 1.0, int inOffset = 0.0);
+  static TablePtr getColorMapTable(ColorMapIndex inIndex, unsigned int inColorNum,
+                          unsigned int inMultiNum = 1,
+                          double inGain = 1.0, int inOffset = 0);
+  static TablePtr getMonoMapTable(unsigned int inColorNum, double inGamma = 1.0,
+                          double inGain = 1.0, int inOffset = 0);
   static void calcLinearColorMap(const unsigned char *inRgb0, const unsigned char *inRgb1,
                                  unsigned int inOffset, unsigned int inColorNumAll,
                                  unsigned int inMapNum, unsigned char *outColorMap);
   static void calcDivergingColorMap(const unsigned char *inRgb0, const unsigned char *inRgb1,
                                     unsigned int inOffset, unsigned int inColorNumAll,
                                     unsigned int inMapNum, unsigned char *outColorMap);
+  static bool getDivergingEndPoints(const double *inMsh0, const double *inMsh1,
+                                    double outLowerMsh[2][3], double outUpperMsh[2][3]);
+  static void calcMshRamp(const double *inMsh0, const double *inMsh1,
+                          double inInterp, double inInterpStep,
+                          unsigned int inNum, unsigned char *outColorMap);
   static void interpolateColor(const unsigned char *inRgb0, const unsigned char *inRgb1,
                    double inInterp, unsigned char *outRgb);
   static double adjustHue(const double *inMsh, double inMunsat);
@@ -87,6 +104,7 @@ public:
   static void convXyzD50ToLinRgb(const double *inXyz, double *outRgbL);
   static void convRgbToLinRGB(const unsigned char *inRgb, double *outRgbL);
   static void convLinRgbToRGB(const double *inRgbL, unsigned char *outRgb);
+  static unsigned char convLinToSRGB8(double inValue);
   static ColorMapIndex stringToColorMapIndex(const char *inString,
                             ColorMapIndex inDefault = CMI_NOT_SPECIFIED);
   static void getColorMapNameTable( std::vector<std::string> *outStrTable,
@@ -0,0 +1,181 @@
+// =============================================================================
+//  ConstexprMath.h
+//
+//  Written in 2022 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     ConstexprMath.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0-pre_alpha.0
+  \date     2022/04/16
+*/
+#ifndef QIV_CONSTEXPR_MATH_H
+#define QIV_CONSTEXPR_MATH_H
+
+// -----------------------------------------------------------------------------
+// ConstexprMath class
+// -----------------------------------------------------------------------------
+//  Minimal constexpr versions of the <cmath> functions that the built-in
+//  tables need (std:: functions are not constexpr in C++17). Accuracy is close
+//  to (but not always bit exact with) the C library. Use at compile time only
+class ConstexprMath
+{
+public:
+  // Constants -----------------------------------------------------------------
+  static constexpr double PI    = 3.14159265358979323846;
+  static constexpr double LN2   = 0.69314718055994530942;
+
+  // Static Functions ----------------------------------------------------------
+  static constexpr double fabs(double inX)
+  {
+    return inX < 0 ? -inX : inX;
+  }
+
+  static constexpr double sqrt(double inX)
+  {
+    if (inX <= 0)
+      return 0;
+    double  x = inX >= 1 ? inX : 1;
+    for (int i = 0; i < 100; i++)   // Newton's method (converges from above)
+    {
+      double  next = 0.5 * (x + inX / x);
+      if (next >= x)
+        break;
+      x = next;
+    }
+    return x;
+  }
+
+  static constexpr double exp(double inX)
+  {
+    // exp(x) = 2^k * exp(r), |r| <= ln2 / 2
+    int     k = (int )(inX / LN2 + (inX < 0 ? -0.5 : 0.5));
+    double  r = inX - k * LN2;
+    double  sum = 1, term = 1;
+    for (int i = 1; i < 30 && sum + term != sum; i++)
+    {
+      term *= r / i;
+      sum += term;
+    }
+    for (; k > 0; k--)
+      sum *= 2;
+    for (; k < 0; k++)
+      sum /= 2;
+    return sum;
+  }
+
+  static constexpr double log(double inX)
+  {
+    if (inX <= 0)
+      return -1.0e300;
+    // log(x) = k * ln2 + log(m), 0.75 <= m < 1.5
+    int     k = 0;
+    while (inX >= 1.5)
+    {
+      inX /= 2;
+      k++;
+    }
+    while (inX < 0.75)
+    {
+      inX *= 2;
+      k--;
+    }
+    // log(m) = 2 * atanh((m - 1) / (m + 1))
+    double  z = (inX - 1) / (inX + 1);
+    double  z2 = z * z, term = z, sum = 0;
+    for (int i = 1; i < 60 && sum + term != sum; i += 2)
+    {
+      sum += term / i;
+      term *= z2;
+    }
+    return 2 * sum + k * LN2;
+  }
+
+  static constexpr double pow(double inX, double inY)
+  {
+    if (inY == 0)
+      return 1;
+    if (inY == 1)
+      return inX;
+    if (inX <= 0)
+      return 0;
+    return exp(inY * log(inX));
+  }
+
+  static constexpr double sin(double inX)
+  {
+    // Reduce to [-PI, PI]
+    while (inX > PI)
+      inX -= 2 * PI;
+    while (inX < -PI)
+      inX += 2 * PI;
+    double  x2 = inX * inX, term = inX, sum = inX;
+    for (int i = 1; i < 30 && sum + term != sum; i++)
+    {
+      term *= -x2 / ((2 * i) * (2 * i + 1));
+      sum += term;
+    }
+    return sum;
+  }
+
+  static constexpr double cos(double inX)
+  {
+    while (inX > PI)
+      inX -= 2 * PI;
+    while (inX < -PI)
+      inX += 2 * PI;
+    double  x2 = inX * inX, term = 1, sum = 1;
+    for (int i = 1; i < 30 && sum + term != sum; i++)
+    {
+      term *= -x2 / ((2 * i - 1) * (2 * i));
+      sum += term;
+    }
+    return sum;
+  }
+
+  static constexpr double atan(double inX)
+  {
+    if (inX < 0)
+      return -atan(-inX);
+    if (inX > 1)
+      return PI / 2 - atan(1 / inX);
+    // Halve the angle twice : atan(x) = 2 * atan(x / (1 + sqrt(1 + x^2)))
+    double  x = inX;
+    for (int i = 0; i < 2; i++)
+      x = x / (1 + sqrt(1 + x * x));
+    double  x2 = x * x, term = x, sum = 0;
+    for (int i = 1; i < 80 && sum + term != sum; i += 2)
+    {
+      sum += term / i;
+      term *= -x2;
+    }
+    return 4 * sum;
+  }
+
+  static constexpr double atan2(double inY, double inX)
+  {
+    if (inX > 0)
+      return atan(inY / inX);
+    if (inX < 0)
+      return inY >= 0 ? atan(inY / inX) + PI : atan(inY / inX) - PI;
+    if (inY > 0)
+      return PI / 2;
+    if (inY < 0)
+      return -PI / 2;
+    return 0;
+  }
+
+  static constexpr double acos(double inX)
+  {
+    return atan2(sqrt((1 - inX) * (1 + inX)), inX);
+  }
+};
+
+#endif //QIV_CONSTEXPR_MATH_H
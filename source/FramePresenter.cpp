@@ -0,0 +1,198 @@
+// =============================================================================
+//  FramePresenter.cpp
+//
+//  Written in 2022 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     FramePresenter.cpp
+  \author   Dairoku Sekiguchi
+  \version  1.0.0-pre_alpha.0
+  \date     2022/04/19
+*/
+
+// Includes --------------------------------------------------------------------
+#include <QGuiApplication>
+#include <QScreen>
+#include <QThread>
+#include "FramePresenter.h"
+
+// -----------------------------------------------------------------------------
+// FramePresenter
+// -----------------------------------------------------------------------------
+FramePresenter::FramePresenter(QObject *parent) :
+  QObject(parent),
+  mTimer(this),
+  mLastPresentTime(0),
+  mMaxFrameRate(0),
+  mPendingFlag(false),
+  mCommittedGeneration(0),
+  mBaseGeneration(0),
+  mPresentedGeneration(0),
+  mPresentedFrameNum(0),
+  mDroppedFrameNum(0)
+{
+  mTimer.setSingleShot(true);
+  mTimer.setTimerType(Qt::PreciseTimer);
+  connect(&mTimer, &QTimer::timeout, this, &FramePresenter::present);
+  mClock.start();
+}
+
+// Member functions ------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// setPresentFunction
+// -----------------------------------------------------------------------------
+void FramePresenter::setPresentFunction(const std::function<void()> &inFunction)
+{
+  mPresentFunction = inFunction;
+}
+
+// -----------------------------------------------------------------------------
+// setMaxFrameRate
+// -----------------------------------------------------------------------------
+//  0 (default) follows the refresh rate of the screen
+void FramePresenter::setMaxFrameRate(double inFrameRate)
+{
+  if (inFrameRate < 0)
+    inFrameRate = 0;
+  mMaxFrameRate = inFrameRate;
+}
+
+// -----------------------------------------------------------------------------
+// getMaxFrameRate
+// -----------------------------------------------------------------------------
+double FramePresenter::getMaxFrameRate() const
+{
+  return mMaxFrameRate;
+}
+
+// -----------------------------------------------------------------------------
+// requestPresent
+// -----------------------------------------------------------------------------
+//  Thread safe. Only the first request after a present schedules the timer,
+//  the others are merged into the same present
+void FramePresenter::requestPresent()
+{
+  if (mPendingFlag.exchange(true))
+    return;
+  if (QThread::currentThread() == thread())
+    schedule();
+  else
+    QMetaObject::invokeMethod(this, "schedule", Qt::QueuedConnection);
+}
+
+// -----------------------------------------------------------------------------
+// frameCommitted
+// -----------------------------------------------------------------------------
+//  Thread safe. inGeneration is that of the frame just published (incremented
+//  by one for every frame, see ImageData::commitFrame())
+void FramePresenter::frameCommitted(uint64_t inGeneration)
+{
+  mCommittedGeneration = inGeneration;
+}
+
+// -----------------------------------------------------------------------------
+// framePresented
+// -----------------------------------------------------------------------------
+//  Called in the GUI thread when the widgets are given the frame of
+//  inGeneration. The same frame again (a redraw) is not counted, and the
+//  frames published between the last one and this one were never shown
+void FramePresenter::framePresented(uint64_t inGeneration)
+{
+  if (inGeneration <= mPresentedGeneration)
+    return;
+  uint64_t  base = mBaseGeneration;
+  if (inGeneration > base)
+  {
+    uint64_t  last = mPresentedGeneration > base ? mPresentedGeneration : base;
+    mPresentedFrameNum++;
+    mDroppedFrameNum += inGeneration - last - 1;
+  }
+  mPresentedGeneration = inGeneration;
+}
+
+// -----------------------------------------------------------------------------
+// getRequestedFrameNum
+// -----------------------------------------------------------------------------
+//  Frames committed since resetCounters()
+uint64_t FramePresenter::getRequestedFrameNum() const
+{
+  return mCommittedGeneration - mBaseGeneration;
+}
+
+// -----------------------------------------------------------------------------
+// getPresentedFrameNum
+// -----------------------------------------------------------------------------
+uint64_t FramePresenter::getPresentedFrameNum() const
+{
+  return mPresentedFrameNum;
+}
+
+// -----------------------------------------------------------------------------
+// getDroppedFrameNum
+// -----------------------------------------------------------------------------
+//  Frames that were replaced by a later one before they were presented (the
+//  ones still waiting are not counted)
+uint64_t FramePresenter::getDroppedFrameNum() const
+{
+  return mDroppedFrameNum;
+}
+
+// -----------------------------------------------------------------------------
+// resetCounters
+// -----------------------------------------------------------------------------
+void FramePresenter::resetCounters()
+{
+  mBaseGeneration = mCommittedGeneration.load();
+  mPresentedFrameNum = 0;
+  mDroppedFrameNum = 0;
+}
+
+// -----------------------------------------------------------------------------
+// schedule
+// -----------------------------------------------------------------------------
+//  Presents at one frame interval after the last present (immediately if the
+//  display has been idle longer than that)
+void FramePresenter::schedule()
+{
+  if (mTimer.isActive())
+    return;
+  qint64  wait = mLastPresentTime + getFrameInterval() - mClock.nsecsElapsed();
+  mTimer.start(wait > 0 ? (int )((wait + 999999) / 1000000) : 0);
+}
+
+// -----------------------------------------------------------------------------
+// present
+// -----------------------------------------------------------------------------
+void FramePresenter::present()
+{
+  // Clear the flag first so that a request made while presenting (or by the
+  // present function itself) schedules the next one
+  mPendingFlag = false;
+  mLastPresentTime = mClock.nsecsElapsed();
+  if (mPresentFunction)
+    mPresentFunction();
+}
+
+// -----------------------------------------------------------------------------
+// getFrameInterval
+// -----------------------------------------------------------------------------
+//  Returns the minimum time between two presents (ns)
+qint64 FramePresenter::getFrameInterval() const
+{
+  double  frameRate = mMaxFrameRate;
+  if (frameRate <= 0)
+  {
+    QScreen *screen = QGuiApplication::primaryScreen();
+    frameRate = screen != nullptr ? screen->refreshRate() : 0;
+    if (frameRate <= 0)
+      frameRate = DEFAULT_REFRESH_RATE;
+  }
+  return (qint64 )(1.0e9 / frameRate);
+}
@@ -0,0 +1,88 @@
+// =============================================================================
+//  FramePresenter.h
+//
+//  Written in 2022 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     FramePresenter.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0-pre_alpha.0
+  \date     2022/04/19
+*/
+#ifndef QIV_FRAME_PRESENTER_H
+#define QIV_FRAME_PRESENTER_H
+
+// Includes --------------------------------------------------------------------
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTimer>
+
+// -----------------------------------------------------------------------------
+// FramePresenter class
+// -----------------------------------------------------------------------------
+//  Coalesces the redraw requests of an ImageData and calls the present
+//  function at most once per display refresh (or per 1 / max frame rate).
+//  Requests that arrive before the next present are merged into it, so a
+//  producer faster than the display only costs the frames that are shown
+//  (the data is converted at paint time, so the newest frame is always used).
+//  requestPresent() can be called from any thread, the present function is
+//  called in the thread of this object (the GUI thread).
+//  The frame statistics count the published frames only (frameCommitted() /
+//  framePresented()), the redraws of the UI (window / level, colormap, ...)
+//  are presented all the same but are not frames
+class FramePresenter : public QObject
+{
+Q_OBJECT
+
+public:
+  // Constants -----------------------------------------------------------------
+  const static int  DEFAULT_REFRESH_RATE = 60;  // When the screen doesn't tell
+
+  // Constructors and Destructor -----------------------------------------------
+  FramePresenter(QObject *parent = nullptr);
+
+  // Member functions ----------------------------------------------------------
+  void setPresentFunction(const std::function<void()> &inFunction);
+  void setMaxFrameRate(double inFrameRate);
+  double getMaxFrameRate() const;
+  void requestPresent();
+  void frameCommitted(uint64_t inGeneration);
+  void framePresented(uint64_t inGeneration);
+  uint64_t getRequestedFrameNum() const;
+  uint64_t getPresentedFrameNum() const;
+  uint64_t getDroppedFrameNum() const;
+  void resetCounters();
+
+private slots:
+  void schedule();
+  void present();
+
+private:
+  // Member variables ----------------------------------------------------------
+  std::function<void()> mPresentFunction;
+  QTimer        mTimer;
+  QElapsedTimer mClock;
+  qint64        mLastPresentTime;     // mClock time of the last present (ns)
+  double        mMaxFrameRate;        // 0 : display refresh rate
+  std::atomic<bool>     mPendingFlag;
+  std::atomic<uint64_t> mCommittedGeneration;  // Of the last committed frame
+  std::atomic<uint64_t> mBaseGeneration;       // mCommittedGeneration at resetCounters()
+  uint64_t              mPresentedGeneration;  // Of the last presented frame (GUI thread)
+  std::atomic<uint64_t> mPresentedFrameNum;
+  std::atomic<uint64_t> mDroppedFrameNum;
+
+  // Member functions ----------------------------------------------------------
+  qint64  getFrameInterval() const;
+};
+
+#endif //QIV_FRAME_PRESENTER_H
@@ -18,17 +18,48 @@
 */
 
 // Includes --------------------------------------------------------------------
+#include <cmath>
 #include <cstring>
+#include <new>
+#include <thread>
+#include <utility>
+#include <QThread>
+#include <QtConcurrent>
 #include "ImageData.h"
+#include "PixelKernels.h"
+#include "PixelRange.h"
 
 // -----------------------------------------------------------------------------
 // ImageData
 // -----------------------------------------------------------------------------
 ImageData::ImageData()
 {
-  mImageBuffer = nullptr;
-  setImageModifiedFlag(false);
+  for (size_t i = 0; i < FRAME_SLOT_NUM; i++)
+    mFrameSlots[i].readerNum = 0;
+  mPublishedSlot = 0;
+  mFrameGeneration = 0;
+  mTileXNum = 0;
+  mTileYNum = 0;
+  mDirtyTileNum = 0;
   mQImage = nullptr;
+  mDisplayType = DISPLAY_TYPE_NOT_SUPPORTED;
+  mColorMapIndex = ColorMap::CMI_NOT_SPECIFIED;
+  mOverlayColor = 0;
+  mSymmetricWindowFlag = false;
+  mIndexTableParams = {0, 0.0, 0};
+  mIndexTableIsIdentity = false;
+  mIndexNarrowShift = -1;
+  mWideWindowLow = 0;
+  mWideWindowShift = 0;
+  mDisplayGeneration = 0;
+  mPresenter.setPresentFunction([this]() { presentAllWidgets(); });
+  mGeneration = std::make_shared<std::atomic<unsigned int>>(0);
+  mModifiedCount = 0;
+  mConversionClock.start();
+  mWaitStartTime = 0;
+  QObject::connect(&mConversionWatcher, &QFutureWatcher<bool>::finished,
+                   &mConversionWatcher, [this]() { conversionFinished(); });
+  resetWindowLevel();
 }
 
 // -----------------------------------------------------------------------------
@@ -36,52 +67,132 @@ ImageData::ImageData()
 // -----------------------------------------------------------------------------
 ImageData::~ImageData()
 {
+  cancelConversion();
   disposeQImage();
-
-  if (mImageBuffer != nullptr)
-    delete mImageBuffer;
 }
 
 // Member functions ------------------------------------------------------------
 // -----------------------------------------------------------------------------
 // allocate
 // -----------------------------------------------------------------------------
+//  Publishes a frame of inFormat filled with 0 (beginFrame() gives one to
+//  fill before it is published)
 bool ImageData::allocate(const ImageFormat &inFormat)
 {
-  if (inFormat.isValid() == false)
+  PendingFramePtr frame = beginFrame(inFormat);
+  if (frame == nullptr)
+    return false;
+  memset(frame->buffer.get(), 0, inFormat.bufferSize());
+  return commitFrame(std::move(frame));
+}
+
+// -----------------------------------------------------------------------------
+// copy
+// -----------------------------------------------------------------------------
+//  Can be called from any thread (e.g. a camera callback). The data is copied
+//  into a frame that no reader holds and then published, so neither side
+//  waits for the other. The display follows at the next present
+bool ImageData::copy(const void *inImagePtr, const ImageFormat &inFormat)
+{
+  if (inImagePtr == nullptr)
     return false;
+  PendingFramePtr frame = beginFrame(inFormat);
+  if (frame == nullptr)
+    return false;
+  memcpy(frame->buffer.get(), inImagePtr, inFormat.bufferSize());
+  return commitFrame(std::move(frame));
+}
 
-  if (mImageBuffer != nullptr)
+// -----------------------------------------------------------------------------
+// beginFrame
+// -----------------------------------------------------------------------------
+//  Returns a frame of inFormat that no reader can see (nullptr : invalid
+//  format or out of memory). Its contents are undefined, fill frame->buffer
+//  in place and publish it with commitFrame(). Any thread. The frames that
+//  no reader holds any more are reused
+ImageData::PendingFramePtr ImageData::beginFrame(const ImageFormat &inFormat)
+{
+  if (inFormat.isValid() == false)
+    return nullptr;
+
+  PendingFramePtr frame;
   {
-    if (mImageFormat.bufferSize() == inFormat.bufferSize())
+    std::lock_guard<std::mutex> lock(mWriterMutex);
+    for (auto it = mFramePool.begin(); it != mFramePool.end(); it++)
     {
-      mImageFormat = inFormat;
-      return true;
+      if (it->use_count() != 1 || (*it)->format.bufferSize() != inFormat.bufferSize())
+        continue;
+      frame = std::move(*it);
+      mFramePool.erase(it);
+      break;
     }
-    delete mImageBuffer;
-    mImageBuffer = nullptr;
   }
-
-  mImageFormat = inFormat;
-  mImageBuffer = new unsigned char[mImageFormat.bufferSize()];
-  if (mImageBuffer == nullptr)
-    return false;
-
-  parameterModified();
-  return true;
+  // The last reader has released it, see its reads before writing
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (frame == nullptr)
+  {
+    frame = std::make_shared<Frame>();
+    frame->buffer.reset(new (std::nothrow) unsigned char[inFormat.bufferSize()]);
+    if (frame->buffer == nullptr)
+      return nullptr;
+  }
+  frame->format = inFormat;
+  frame->generation = 0;
+  return frame;
 }
 
 // -----------------------------------------------------------------------------
-// copy
+// commitFrame
 // -----------------------------------------------------------------------------
-bool ImageData::copy(const void *inImagePtr, const ImageFormat &inFormat)
+//  Publishes a frame of beginFrame(). It must not be written any more (the
+//  readers may hold it from now on). The readers are never blocked : the
+//  frame is put in a slot that is neither published nor pinned by a reader
+//  and then the index of the published slot is switched (see getFrame())
+bool ImageData::commitFrame(PendingFramePtr inFrame)
 {
-  if (allocate(inFormat) == false)
+  if (inFrame == nullptr)
     return false;
 
-  memcpy(mImageBuffer, inImagePtr, mImageFormat.bufferSize());
+  uint64_t  generation;
+  {
+    std::lock_guard<std::mutex> lock(mWriterMutex);
+    generation = ++mFrameGeneration;
+    inFrame->generation = generation;
+
+    // The slots are pinned only while a pointer is copied, so there is
+    // always a free one but for a reader that is preempted right then
+    unsigned int  published = mPublishedSlot.load();
+    unsigned int  index = published;
+    while (index == published)
+    {
+      for (unsigned int i = 0; i < FRAME_SLOT_NUM; i++)
+        if (i != published && mFrameSlots[i].readerNum.load() == 0)
+        {
+          index = i;
+          break;
+        }
+      if (index == published)
+        std::this_thread::yield();
+    }
+    if (mFrameSlots[index].frame != nullptr)
+      releaseFrame(std::move(mFrameSlots[index].frame));
+    mFrameSlots[index].frame = std::move(inFrame);
+    mPublishedSlot.store(index);
 
-  setImageModifiedFlag(true);
+    // A reader that pins an other slot from now on finds it not published
+    // and leaves it, so the ones not pinned now can be released
+    for (unsigned int i = 0; i < FRAME_SLOT_NUM; i++)
+      if (i != index && mFrameSlots[i].frame != nullptr &&
+          mFrameSlots[i].readerNum.load() == 0)
+        releaseFrame(std::move(mFrameSlots[i].frame));
+    mPresenter.frameCommitted(generation);  // In order of the generations
+  }
+
+  // The writer in the GUI thread sees the new format at once, the others at
+  // the next present
+  if (QThread::currentThread() == mPresenter.thread())
+    syncFrame();
+  redrawAllWidgets();
   return true;
 }
 
@@ -90,76 +201,299 @@ bool ImageData::copy(const void *inImagePtr, const ImageFormat &inFormat)
 // -----------------------------------------------------------------------------
 bool ImageData::check() const
 {
-  if (getData() == nullptr || mQImage == nullptr || mImageFormat.isValid() == false)
+  if (mDisplayFrame == nullptr || mQImage == nullptr || mImageFormat.isValid() == false)
     return false;
   return true;
 }
 
+// -----------------------------------------------------------------------------
+// getFrame
+// -----------------------------------------------------------------------------
+//  The snapshot of the published frame (nullptr : none yet). Safe from any
+//  thread, the frame stays valid while the returned pointer is held. Lock
+//  free, not wait free : the slot is pinned while the pointer is copied and
+//  this is tried again only when a frame was published in between (the
+//  writers never hold a reader)
+ImageData::FramePtr ImageData::getFrame() const
+{
+  for (;;)
+  {
+    unsigned int    index = mPublishedSlot.load();
+    const FrameSlot &slot = mFrameSlots[index];
+    slot.readerNum.fetch_add(1);
+    if (mPublishedSlot.load() == index)
+    {
+      FramePtr  frame = slot.frame;
+      slot.readerNum.fetch_sub(1);
+      return frame;
+    }
+    slot.readerNum.fetch_sub(1);
+  }
+}
+
 // -----------------------------------------------------------------------------
 // getData
 // -----------------------------------------------------------------------------
-void *ImageData::getData() const
+//  The buffer of the published frame (read only, see beginFrame())
+const void *ImageData::getData() const
 {
-  return mImageBuffer;
+  FramePtr  frame = getFrame();
+  if (frame == nullptr)
+    return nullptr;
+  return frame->buffer.get();
+}
+
+// -----------------------------------------------------------------------------
+// getDisplayImage
+// -----------------------------------------------------------------------------
+const QImage *ImageData::getDisplayImage() const
+{
+  return mQImage;
+}
+
+// -----------------------------------------------------------------------------
+// getDisplayGeneration
+// -----------------------------------------------------------------------------
+//  Changed whenever the pixels or the color table of the display image are
+//  changed (the render caches are made again)
+unsigned int ImageData::getDisplayGeneration() const
+{
+  return mDisplayGeneration;
 }
 
 // -----------------------------------------------------------------------------
 // getFormat
 // -----------------------------------------------------------------------------
+//  The format of the displayed frame (GUI thread). The other threads should
+//  use getFrame()->format
 const ImageFormat &ImageData::getFormat() const
 {
   return mImageFormat;
 }
 
 // -----------------------------------------------------------------------------
-// setImageModifiedFlag
+// getPixelValue
 // -----------------------------------------------------------------------------
-void  ImageData::setImageModifiedFlag(bool inFlag)
+bool ImageData::getPixelValue(unsigned int inX, unsigned int inY,
+                              PixelValue *outValue) const
+{
+  // Read the source buffer directly (not mQImage) to get the raw values
+  FramePtr  frame = getFrame();
+  if (frame == nullptr)
+    return false;
+  return frame->format.getPixelValue(frame->buffer.get(), inX, inY, outValue);
+}
+
+// -----------------------------------------------------------------------------
+// getDisplayColor
+// -----------------------------------------------------------------------------
+bool ImageData::getDisplayColor(unsigned int inX, unsigned int inY,
+                                QRgb *outColor) const
 {
-  mImageModifiedFlag = inFlag;
+  if (mQImage == nullptr)
+    return false;
+  if (inX >= (unsigned int )mQImage->width() || inY >= (unsigned int )mQImage->height())
+    return false;
+  *outColor = mQImage->pixel((int )inX, (int )inY);
+  return true;
 }
 
 // -----------------------------------------------------------------------------
-// getImageModifiedFlag
+// setColorMap
 // -----------------------------------------------------------------------------
-bool  ImageData::getImageModifiedFlag() const
+//  CMI_NOT_SPECIFIED displays the image as it is (grayscale). Only the 256
+//  entries of the color table are changed, the pixels are not converted again
+//  (except for the sources wider than 8 bits, see colorMapModified())
+void ImageData::setColorMap(ColorMap::ColorMapIndex inIndex)
 {
-  return mImageModifiedFlag;
+  if (mColorMapIndex == inIndex)
+    return;
+  mColorMapIndex = inIndex;
+  colorMapModified();
 }
 
 // -----------------------------------------------------------------------------
-// update
+// getColorMap
 // -----------------------------------------------------------------------------
-bool ImageData::update(bool inForceUpdate)
+ColorMap::ColorMapIndex ImageData::getColorMap() const
 {
-  if (inForceUpdate == false && getImageModifiedFlag() == false)
-    return false;
+  return mColorMapIndex;
+}
 
-  if (check() == false)
-    return false;
+// -----------------------------------------------------------------------------
+// setOverlayColor
+// -----------------------------------------------------------------------------
+//  Makes the display image an overlay (see ImageView::setOverlayData()) : the
+//  pixels of index 0 are transparent, the others are inColor (with its alpha).
+//  Meant for masks (1-bit : 0 / 1). An alpha of 0 returns to the colormap
+void ImageData::setOverlayColor(QRgb inColor)
+{
+  if (mOverlayColor == inColor)
+    return;
+  mOverlayColor = inColor;
+  colorMapModified();
+}
+
+// -----------------------------------------------------------------------------
+// getOverlayColor
+// -----------------------------------------------------------------------------
+QRgb ImageData::getOverlayColor() const
+{
+  return mOverlayColor;
+}
+
+// -----------------------------------------------------------------------------
+// setWindowLevel
+// -----------------------------------------------------------------------------
+//  Source values from (inLevel - inWindow / 2) to (inLevel + inWindow / 2) are
+//  mapped to the full display range (or colormap). Only the index table is
+//  regenerated (at the next conversion), the source is never touched.
+//  Color sources are always displayed as they are
+void ImageData::setWindowLevel(double inWindow, double inLevel)
+{
+  if (mDisplayType != DISPLAY_TYPE_MONO && mDisplayType != DISPLAY_TYPE_MONO_RGB)
+    return;
+  double  range = getWindowLevelRange();
+  if (inWindow < 2.0)
+    inWindow = 2.0;
+  if (inWindow > range * 2)
+    inWindow = range * 2;
+  if (inLevel < -range)
+    inLevel = -range;
+  if (inLevel > range * 2)
+    inLevel = range * 2;
+  if (mSymmetricWindowFlag && mImageFormat.type().isSigned())
+    inLevel = 0.0;
+  if (inWindow == mWindow && inLevel == mLevel)
+    return;
+  mWindow = inWindow;
+  mLevel  = inLevel;
+  markAllTilesDirty();
+}
 
-  // Sanity check here
-  if ((unsigned int )mQImage->width()  != mImageFormat.width() ||
-      (unsigned int )mQImage->height() != mImageFormat.height())
-    return false; // Should throw exception?
+// -----------------------------------------------------------------------------
+// setSymmetricWindow
+// -----------------------------------------------------------------------------
+//  true keeps the window of signed sources centered on 0 (only the width is
+//  changed), so that 0 stays at the center of a diverging colormap
+void ImageData::setSymmetricWindow(bool inFlag)
+{
+  mSymmetricWindowFlag = inFlag;
+  if (inFlag)
+    setWindowLevel(mWindow, 0.0);
+}
 
-  // TODO: this code assumes that ImageType is PIXEL_TYPE_MONO
-  unsigned char *src = (unsigned char *)mImageBuffer;
-  unsigned char *dst = (unsigned char *)mQImage->bits();
-  size_t bufSize = mImageFormat.bufferSize();
+// -----------------------------------------------------------------------------
+// getSymmetricWindow
+// -----------------------------------------------------------------------------
+bool ImageData::getSymmetricWindow() const
+{
+  return mSymmetricWindowFlag;
+}
 
-  for (size_t i = 0; i < bufSize; i++)
+// -----------------------------------------------------------------------------
+// getWindowLevel
+// -----------------------------------------------------------------------------
+void ImageData::getWindowLevel(double *outWindow, double *outLevel) const
+{
+  *outWindow = mWindow;
+  *outLevel  = mLevel;
+}
+
+// -----------------------------------------------------------------------------
+// resetWindowLevel
+// -----------------------------------------------------------------------------
+//  The window of the signed values is centered on 0
+void ImageData::resetWindowLevel()
+{
+  double  range = getWindowLevelRange();
+  mWindow = range;
+  mLevel  = mImageFormat.type().isSigned() ? 0.0 : range / 2;
+  markAllTilesDirty();
+}
+
+// -----------------------------------------------------------------------------
+// getWindowLevelRange
+// -----------------------------------------------------------------------------
+//  Returns the number of source values (2 ^ bit width)
+double ImageData::getWindowLevelRange() const
+{
+  unsigned int  bitWidth = getDisplayBitWidth();
+  if (bitWidth == 0)
+    return 256.0;
+  return ldexp(1.0, (int )bitWidth);
+}
+
+// -----------------------------------------------------------------------------
+// setBitWindow
+// -----------------------------------------------------------------------------
+//  Displays the 8 bits from inLowBit (source bits inLowBit to inLowBit + 7
+//  as the display range, the larger values saturate). Signed sources get
+//  the same window centered on 0. Any window / level works for any source,
+//  this is the natural one for the values wider than 16 bits, which are
+//  shifted rather than looked up (see updateIndexTable())
+void ImageData::setBitWindow(unsigned int inLowBit)
+{
+  unsigned int  bitWidth = getDisplayBitWidth();
+  if (bitWidth == 0)
+    return;
+  if (inLowBit + 8 > bitWidth)
+    inLowBit = bitWidth > 8 ? bitWidth - 8 : 0;
+  double  window = ldexp(1.0, (int )inLowBit + 8);
+  setWindowLevel(window, mImageFormat.type().isSigned() ? 0.0 : window / 2);
+}
+
+// -----------------------------------------------------------------------------
+// setImageModifiedFlag
+// -----------------------------------------------------------------------------
+//  true marks the whole image for the conversion
+void  ImageData::setImageModifiedFlag(bool inFlag)
+{
+  if (inFlag)
   {
-    for (int j = 0; j < 3; j++)
-    {
-      *dst = *src;
-      dst++;
-    }
-    src++;
+    syncFrame();
+    markAllTilesDirty();
+    return;
   }
+  mTileDirtyTable.assign(mTileDirtyTable.size(), false);
+  mDirtyTileNum = 0;
+}
 
-  setImageModifiedFlag(false);
-  return true;
+// -----------------------------------------------------------------------------
+// getImageModifiedFlag
+// -----------------------------------------------------------------------------
+//  Also true when a frame was published since the last syncFrame()
+bool  ImageData::getImageModifiedFlag() const
+{
+  if (mDirtyTileNum != 0)
+    return true;
+  FramePtr  frame = getFrame();
+  return frame != nullptr &&
+         (mDisplayFrame == nullptr || frame->generation != mDisplayFrame->generation);
+}
+
+// -----------------------------------------------------------------------------
+// startConversion
+// -----------------------------------------------------------------------------
+//  Converts the modified data into a new display image in the background. The
+//  widgets are redrawn when it completes, until then they draw the previous
+//  one. Nothing is done when a conversion is running (conversionFinished()
+//  starts the next one)
+bool ImageData::startConversion()
+{
+  syncFrame();
+  if (mConversionJob != nullptr)
+    return true;
+  mWaitStartTime = mConversionClock.elapsed();
+  return startConversionJob();
+}
+
+// -----------------------------------------------------------------------------
+// isConverting
+// -----------------------------------------------------------------------------
+bool ImageData::isConverting() const
+{
+  return mConversionJob != nullptr;
 }
 
 // -----------------------------------------------------------------------------
@@ -170,6 +504,16 @@ void ImageData::draw(QPainter &inPainter, const QRect &rect)
   inPainter.drawImage(rect, *mQImage);
 }
 
+// -----------------------------------------------------------------------------
+// draw
+// -----------------------------------------------------------------------------
+//  Draws only inSourceRect of the image (scaled to inTargetRect), so the cost
+//  depends on the exposed area instead of the zoomed image size
+void ImageData::draw(QPainter &inPainter, const QRectF &inTargetRect, const QRect &inSourceRect)
+{
+  inPainter.drawImage(inTargetRect, *mQImage, QRectF(inSourceRect));
+}
+
 // -----------------------------------------------------------------------------
 // addWidget
 // -----------------------------------------------------------------------------
@@ -192,10 +536,123 @@ void  ImageData::removeWidget(ViewDataInterface *inWidget)
 // -----------------------------------------------------------------------------
 // redrawAllWidgets
 // -----------------------------------------------------------------------------
+//  The widgets are not redrawn here but at the next present of mPresenter, so
+//  any number of calls (from any thread) within a display frame cost one
+//  conversion of the newest data
 void  ImageData::redrawAllWidgets()
 {
-  for (auto it = mWidgetList.begin(); it != mWidgetList.end(); it++)
-    (*it)->updateWidget();
+  FramePtr  frame = getFrame();
+  if (frame == nullptr)
+  {
+    mPresenter.requestPresent();
+    return;
+  }
+  redrawAllWidgets(QRect(0, 0, (int )frame->format.width(), (int )frame->format.height()));
+}
+
+// -----------------------------------------------------------------------------
+// redrawAllWidgets
+// -----------------------------------------------------------------------------
+//  inDirtyRect (image coordinates) is merged into the pending one. However many
+//  calls come from whatever threads, there is at most one present queued and
+//  each widget gets one updateWidget() with the merged rect (in the GUI thread)
+void  ImageData::redrawAllWidgets(const QRect &inDirtyRect)
+{
+  {
+    std::lock_guard<std::mutex> lock(mNotificationMutex);
+    mPendingDirtyRect |= inDirtyRect;
+  }
+  mPresenter.requestPresent();
+}
+
+// -----------------------------------------------------------------------------
+// getPresenter
+// -----------------------------------------------------------------------------
+FramePresenter *ImageData::getPresenter()
+{
+  return &mPresenter;
+}
+
+// -----------------------------------------------------------------------------
+// acquireRenderCache
+// -----------------------------------------------------------------------------
+//  Views with the same key share one cache (the display image is converted
+//  once for all of them in any case). A cache is released with its last view
+std::shared_ptr<RenderCache> ImageData::acquireRenderCache(const RenderCacheKey &inKey)
+{
+  std::shared_ptr<RenderCache>  cache;
+  auto it = mRenderCacheList.begin();
+  while (it != mRenderCacheList.end())
+  {
+    std::shared_ptr<RenderCache>  item = it->lock();
+    if (item == nullptr)
+    {
+      it = mRenderCacheList.erase(it);
+      continue;
+    }
+    if (item->getKey() == inKey)
+      cache = item;
+    it++;
+  }
+  if (cache != nullptr)
+    return cache;
+  cache = std::make_shared<RenderCache>(inKey);
+  mRenderCacheList.push_back(cache);
+  return cache;
+}
+
+// -----------------------------------------------------------------------------
+// makeColorTable
+// -----------------------------------------------------------------------------
+//  The 256 entry RGB32 color table of a colormap (CMI_NOT_SPECIFIED : grayscale)
+void ImageData::makeColorTable(ColorMap::ColorMapIndex inIndex, uint32_t *outTable)
+{
+  ColorMap::TablePtr  table;
+  if (inIndex == ColorMap::CMI_NOT_SPECIFIED)
+    table = ColorMap::getMonoMapTable(256);
+  else
+    table = ColorMap::getColorMapTable(inIndex, 256);
+  if (table == nullptr || table->size() != 256 * 3)
+  {
+    for (int i = 0; i < 256; i++)
+      outTable[i] = 0xFF000000;
+    return;
+  }
+  PixelKernels::packRGB32Table(table->data(), 256, outTable);
+}
+
+// -----------------------------------------------------------------------------
+// releaseFrame
+// -----------------------------------------------------------------------------
+//  Keeps a frame taken out of its slot for reuse (mWriterMutex). It is
+//  reused only when nobody but the pool refers to it (see beginFrame())
+void  ImageData::releaseFrame(std::shared_ptr<Frame> &&inFrame)
+{
+  if (mFramePool.size() >= FRAME_POOL_SIZE)
+    mFramePool.erase(mFramePool.begin());
+  mFramePool.push_back(std::move(inFrame));
+}
+
+// -----------------------------------------------------------------------------
+// syncFrame
+// -----------------------------------------------------------------------------
+//  Makes the display side (GUI thread) follow the published frame. A new
+//  format reallocates the display image, a new frame marks it for conversion
+void  ImageData::syncFrame()
+{
+  FramePtr  frame = getFrame();
+  if (frame == nullptr ||
+      (mDisplayFrame != nullptr && frame->generation == mDisplayFrame->generation))
+    return;
+
+  bool  formatChanged = (mDisplayFrame == nullptr || frame->format != mImageFormat);
+  mDisplayFrame = frame;
+  if (formatChanged)
+  {
+    mImageFormat = frame->format;
+    parameterModified();
+  }
+  markAllTilesDirty();
 }
 
 // -----------------------------------------------------------------------------
@@ -203,13 +660,817 @@ void  ImageData::redrawAllWidgets()
 // -----------------------------------------------------------------------------
 void  ImageData::parameterModified()
 {
-  disposeQImage();
-  mQImage = new QImage(mImageFormat.width(), mImageFormat.height(),
-                       QImage::Format_RGB888);
-
+  createDisplayImage();
+  mTileXNum = (mImageFormat.width()  + TILE_SIZE - 1) / TILE_SIZE;
+  mTileYNum = (mImageFormat.height() + TILE_SIZE - 1) / TILE_SIZE;
+  mTileDirtyTable.assign((size_t )mTileXNum * mTileYNum, false);
+  mDirtyTileNum = 0;
+  resetWindowLevel();
   setImageModifiedFlag(false);
   for (auto it = mWidgetList.begin(); it != mWidgetList.end(); it++)
     (*it)->setImageSizeChangedFlag(true);
+  redrawAllWidgets();
+}
+
+// -----------------------------------------------------------------------------
+// createDisplayImage
+// -----------------------------------------------------------------------------
+//  Mono sources get Format_Indexed8 (a third of the memory of RGB888 and no
+//  per draw conversion in the raster engine), color sources and colormapped
+//  mono sources wider than 8 bits Format_RGB32 (see DisplayType)
+void  ImageData::createDisplayImage()
+{
+  cancelConversion();
+  mSpareImage = QImage();
+  mSpareTileStateTable.clear();
+  disposeQImage();
+  mDisplayType = getDisplayType();
+  if (mDisplayType == DISPLAY_TYPE_COLOR || mDisplayType == DISPLAY_TYPE_MONO_RGB)
+    mQImage = new QImage(mImageFormat.width(), mImageFormat.height(),
+                         QImage::Format_RGB32);
+  else
+  {
+    mQImage = new QImage(mImageFormat.width(), mImageFormat.height(),
+                         QImage::Format_Indexed8);
+    updateColorTable();
+  }
+  mQImage->fill(0);   // Shown until the first conversion completes
+  mDisplayGeneration++;
+  mIndexTable.clear();
+  mRgbTable.clear();
+  mIndexTableParams = {0, 0.0, 0};
+}
+
+// -----------------------------------------------------------------------------
+// colorMapModified
+// -----------------------------------------------------------------------------
+//  The colormap or the overlay color was changed. An Indexed8 display image
+//  only gets the new color table, an RGB32 one of a mono source is converted
+//  again (and the display image is made again when its format changes)
+void  ImageData::colorMapModified()
+{
+  if (mQImage != nullptr && getDisplayType() != mDisplayType)
+  {
+    createDisplayImage();
+    markAllTilesDirty();
+  }
+  else if (mDisplayType == DISPLAY_TYPE_MONO_RGB)
+  {
+    mRgbTable.clear();
+    markAllTilesDirty();
+  }
+  else
+    updateColorTable();
+  redrawAllWidgets();
+}
+
+// -----------------------------------------------------------------------------
+// presentAllWidgets
+// -----------------------------------------------------------------------------
+//  Modified data is converted first, the widgets are redrawn when it is done
+void  ImageData::presentAllWidgets()
+{
+  {
+    std::lock_guard<std::mutex> lock(mNotificationMutex);
+    mDisplayDirtyRect |= mPendingDirtyRect;
+    mPendingDirtyRect = QRect();
+  }
+  if (startConversion())
+    return;   // conversionFinished() notifies
+  notifyAllWidgets(mDisplayFrame != nullptr ? mDisplayFrame->generation : 0);
+}
+
+// -----------------------------------------------------------------------------
+// notifyAllWidgets
+// -----------------------------------------------------------------------------
+//  Passes the dirty rect merged since the last notification (GUI thread).
+//  inFrameGeneration is the frame the display image was converted from
+void  ImageData::notifyAllWidgets(uint64_t inFrameGeneration)
+{
+  if (inFrameGeneration != 0)
+    mPresenter.framePresented(inFrameGeneration);
+  QRect dirtyRect = mDisplayDirtyRect.intersected(
+          QRect(0, 0, (int )mImageFormat.width(), (int )mImageFormat.height()));
+  mDisplayDirtyRect = QRect();
+  for (auto it = mWidgetList.begin(); it != mWidgetList.end(); it++)
+    (*it)->updateWidget(this, dirtyRect, inFrameGeneration);
+}
+
+// -----------------------------------------------------------------------------
+// updateIndexTable
+// -----------------------------------------------------------------------------
+//  Makes the table that maps every source value to the 8-bit index of the
+//  color table. Nothing is done when the parameters are not changed, so the
+//  table is made at most once per conversion however many times the window was
+//  changed. The default window comes from the ColorMap cache, the others are
+//  made directly so that dragging the window does not flush the cache
+bool  ImageData::updateIndexTable()
+{
+  unsigned int  bitWidth = getDisplayBitWidth();
+  if (bitWidth == 0)
+    return false;
+  if (bitWidth > 16)
+  {
+    // Too many values for a table : the window is rounded up to a power of
+    // two around the level, which windowWideTo8() applies with a shift
+    int shift = (int )ceil(log2(mWindow)) - 8;
+    shift = shift < 0 ? 0 : (shift > 62 ? 62 : shift);
+    mWideWindowShift = (unsigned int )shift;
+    mWideWindowLow = (int64_t )floor(mLevel - ldexp(1.0, shift + 7) + 0.5);
+    return true;
+  }
+
+  // Map [low, low + mWindow) to [0, 255] (see getMonoMap()). The signed
+  // values index the table in offset binary (see offsetSigned16()), entry i
+  // is the value i - valueNum / 2
+  const ImageType::Descriptor &desc = mImageFormat.type().descriptor();
+  unsigned int  valueNum = 1 << bitWidth;
+  int     offset = -(int )floor(mLevel - mWindow / 2 + 0.5);
+  if (desc.isSigned)
+    offset -= (int )(valueNum / 2);
+  double  gain = (valueNum - 1.0) / (mWindow - 1.0);
+  if (mDisplayType == DISPLAY_TYPE_MONO_RGB)
+    return updateRgbTable(valueNum, gain, offset);
+  if (mIndexTable.empty() == false &&
+      mIndexTableParams.valueNum == valueNum &&
+      mIndexTableParams.gain == gain && mIndexTableParams.offset == offset)
+    return true;
+
+  // The default window of the 16-bit containers is a plain shift (applied by
+  // shiftNarrow16To8(), the table is made all the same for the check above)
+  mIndexNarrowShift = -1;
+  if (gain == 1.0 && offset == 0 && desc.bytesPerComponent == 2 && bitWidth >= 8 &&
+      desc.isSigned == false)
+  {
+    mIndexTable.resize(valueNum);
+    for (unsigned int i = 0; i < valueNum; i++)
+      mIndexTable[i] = (uint8_t )(i >> (bitWidth - 8));
+    mIndexTableIsIdentity = false;
+    mIndexNarrowShift = (int )(bitWidth - 8 + desc.valueShift);
+    mIndexTableParams = {valueNum, gain, offset};
+    return true;
+  }
+
+  const unsigned char *rgbTable;
+  ColorMap::TablePtr  table;
+  if (gain == 1.0 && offset == 0)
+  {
+    table = ColorMap::getMonoMapTable(valueNum);
+    if (table == nullptr || table->size() != valueNum * 3)
+      return false;
+    rgbTable = table->data();
+  }
+  else
+  {
+    mDisplayRgbTable.resize(valueNum * 3);
+    ColorMap::getMonoMap(valueNum, mDisplayRgbTable.data(), 1.0, gain, offset);
+    rgbTable = mDisplayRgbTable.data();
+  }
+
+  mIndexTable.resize(valueNum);
+  mIndexTableIsIdentity = (valueNum == 256);
+  for (unsigned int i = 0; i < valueNum; i++)
+  {
+    mIndexTable[i] = rgbTable[i * 3];
+    if (mIndexTable[i] != i)
+      mIndexTableIsIdentity = false;
+  }
+  // 1 and 4-bit values in bytes go through the 256 entry path, the values
+  // out of the range get the last entry
+  if (mImageFormat.type().sizeOfData() == 1 && valueNum < 256)
+    mIndexTable.resize(256, mIndexTable[valueNum - 1]);
+  mIndexTableParams = {valueNum, gain, offset};
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// updateRgbTable
+// -----------------------------------------------------------------------------
+//  Makes the table that maps every source value to its RGB32 color
+//  (DISPLAY_TYPE_MONO_RGB), the window is applied by the colormap itself.
+//  The parameters are those of updateIndexTable()
+bool  ImageData::updateRgbTable(unsigned int inValueNum, double inGain, int inOffset)
+{
+  if (mRgbTable.empty() == false &&
+      mIndexTableParams.valueNum == inValueNum &&
+      mIndexTableParams.gain == inGain && mIndexTableParams.offset == inOffset)
+    return true;
+
+  const unsigned char *rgbTable;
+  ColorMap::TablePtr  table;
+  if (inGain == 1.0 && inOffset == 0)
+  {
+    table = ColorMap::getColorMapTable(mColorMapIndex, inValueNum);
+    if (table == nullptr || table->size() != inValueNum * 3)
+      return false;
+    rgbTable = table->data();
+  }
+  else
+  {
+    mDisplayRgbTable.resize(inValueNum * 3);
+    ColorMap::getColorMap(mColorMapIndex, inValueNum, mDisplayRgbTable.data(), 1, inGain, inOffset);
+    rgbTable = mDisplayRgbTable.data();
+  }
+  mRgbTable.resize(inValueNum);
+  PixelKernels::packRGB32Table(rgbTable, inValueNum, mRgbTable.data());
+  mIndexTableParams = {inValueNum, inGain, inOffset};
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// updateColorTable
+// -----------------------------------------------------------------------------
+//  Sets the 256 entry color table of the Indexed8 display image
+void  ImageData::updateColorTable()
+{
+  if (mQImage == nullptr || mQImage->format() != QImage::Format_Indexed8)
+    return;
+  if (mConversionJob != nullptr)
+    return;   // Shares the pixels (setColorTable() would copy them), see conversionFinished()
+
+  QVector<QRgb> colorTable(256);
+  if (qAlpha(mOverlayColor) != 0)
+  {
+    // Overlay : index 0 (mask off) is transparent
+    colorTable[0] = 0;
+    for (int i = 1; i < 256; i++)
+      colorTable[i] = mOverlayColor;
+  }
+  else
+    makeColorTable(mColorMapIndex, colorTable.data());
+  mQImage->setColorTable(colorTable);
+  mDisplayGeneration++;
+}
+
+// -----------------------------------------------------------------------------
+// getConversionParams
+// -----------------------------------------------------------------------------
+//  The tables point to mIndexTable and mRgbTable (replace them for a background job)
+ImageData::ConversionParams ImageData::getConversionParams(QImage *inDstImage) const
+{
+  ConversionParams  params;
+  params.format = mImageFormat;
+  params.buffer = mDisplayFrame != nullptr ? mDisplayFrame->buffer.get() : nullptr;
+  params.displayType = mDisplayType;
+  params.indexTable = mIndexTable.data();
+  params.indexTableSize = (unsigned int )mIndexTable.size();
+  params.indexTableIsIdentity = mIndexTableIsIdentity;
+  params.rgbTable = mRgbTable.data();
+  params.rgbTableSize = (unsigned int )mRgbTable.size();
+  params.indexNarrowShift = mIndexNarrowShift;
+  params.valueShift = mImageFormat.type().descriptor().valueShift;
+  params.wideWindowLow = mWideWindowLow;
+  params.wideWindowShift = mWideWindowShift;
+  params.dstBits = inDstImage->bits();
+  params.dstBytesPerLine = inDstImage->bytesPerLine();
+  return params;
+}
+
+// -----------------------------------------------------------------------------
+// startConversionJob
+// -----------------------------------------------------------------------------
+//  The dirty tiles the widgets show are converted first, the others by the
+//  next job. The target is the spare image when there is one : only the tiles
+//  it can't keep are copied from mQImage (the undefined ones and the outdated
+//  ones that are not dirty)
+bool ImageData::startConversionJob()
+{
+  syncFrame();
+  if (check() == false || mDisplayType == DISPLAY_TYPE_NOT_SUPPORTED)
+    return false;
+  if (getImageModifiedFlag() == false)
+    return false;
+  if ((mDisplayType == DISPLAY_TYPE_MONO || mDisplayType == DISPLAY_TYPE_MONO_RGB) &&
+      updateIndexTable() == false)
+    return false;
+
+  std::shared_ptr<ConversionJob>  job = std::make_shared<ConversionJob>();
+  job->generation = *mGeneration;
+  job->currentGeneration = mGeneration;
+  job->modifiedCount = mModifiedCount;
+  job->frame = mDisplayFrame;
+  job->indexTable = mIndexTable;
+  job->rgbTable = mRgbTable;
+
+  size_t  tileNum = mTileDirtyTable.size();
+  QRect   visibleRect = getVisibleImageRect();
+  bool    visibleFlag = false;
+  job->tileTable.assign(tileNum, false);
+  for (size_t i = 0; i < tileNum; i++)
+  {
+    if (mTileDirtyTable[i] && getTileRect(i).intersects(visibleRect))
+    {
+      job->tileTable[i] = true;
+      visibleFlag = true;
+    }
+  }
+  if (visibleFlag == false)
+    job->tileTable = mTileDirtyTable;
+
+  if (mSpareImage.size() == mQImage->size() && mSpareImage.format() == mQImage->format() &&
+      mSpareTileStateTable.size() == tileNum)
+  {
+    job->image.swap(mSpareImage);
+    job->tileStateTable.swap(mSpareTileStateTable);
+  }
+  else
+  {
+    job->image = QImage(mQImage->size(), mQImage->format());
+    job->tileStateTable.assign(tileNum, TILE_STATE_UNDEFINED);
+  }
+  job->copyTable.assign(tileNum, false);
+  for (size_t i = 0; i < tileNum; i++)
+    job->copyTable[i] = job->tileTable[i] == false &&
+                        (job->tileStateTable[i] == TILE_STATE_UNDEFINED ||
+                         (job->tileStateTable[i] == TILE_STATE_OUTDATED &&
+                          mTileDirtyTable[i] == false));
+  job->source = *mQImage;
+  job->params = getConversionParams(&job->image);
+  job->params.indexTable = job->indexTable.data();
+  job->params.rgbTable = job->rgbTable.data();
+  addConversionBands(job->tileTable, false, job.get());
+  addConversionBands(job->copyTable, true, job.get());
+
+  // The job only touches what it holds, so it can outlive this object
+  mConversionJob = job;
+  mConversionWatcher.setFuture(QtConcurrent::run([job]() { return runConversion(*job); }));
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// conversionFinished
+// -----------------------------------------------------------------------------
+//  Called in the GUI thread when the job is done (or cancelled). The next one
+//  is started here : the data was modified while converting, or only the
+//  visible tiles were converted
+void ImageData::conversionFinished()
+{
+  std::shared_ptr<ConversionJob>  job = mConversionJob;
+  mConversionJob.reset();
+  if (job == nullptr || mQImage == nullptr)
+    return;
+
+  if (mConversionWatcher.future().result() == false)
+  {
+    reclaimJobImage(job.get());
+    updateColorTable();
+    if (job->generation == *mGeneration)
+      return;   // Failed (not cancelled), don't retry until the next request
+  }
+  else
+  {
+    // The previous display image is kept for the next job. It differs from
+    // the new one in the converted tiles and the outdated ones not copied
+    mSpareTileStateTable.resize(job->tileTable.size());
+    for (size_t i = 0; i < job->tileTable.size(); i++)
+    {
+      bool  outdated = job->tileTable[i] ||
+                       (job->tileStateTable[i] != TILE_STATE_CURRENT && job->copyTable[i] == false);
+      mSpareTileStateTable[i] = outdated ? TILE_STATE_OUTDATED : TILE_STATE_CURRENT;
+      if (job->tileTable[i])
+        mDisplayDirtyRect |= getTileRect(i);
+    }
+    mQImage->swap(job->image);
+    mSpareImage.swap(job->image);
+    mDisplayGeneration++;
+    updateColorTable();   // The colormap may have been changed meanwhile
+    if (job->modifiedCount == mModifiedCount)
+    {
+      for (size_t i = 0; i < job->tileTable.size(); i++)
+      {
+        if (job->tileTable[i] == false || mTileDirtyTable[i] == false)
+          continue;
+        mTileDirtyTable[i] = false;
+        mDirtyTileNum--;
+      }
+    }
+    mWaitStartTime = mConversionClock.elapsed();
+    notifyAllWidgets(job->frame != nullptr ? job->frame->generation : 0);
+  }
+  if (startConversionJob())
+    return;
+
+  // Nothing left to convert. A large spare image is not kept for the next
+  // change (the next job makes a new one and copies the tiles it needs)
+  if ((size_t )mSpareImage.bytesPerLine() * mSpareImage.height() > SPARE_IMAGE_SIZE_MAX)
+  {
+    mSpareImage = QImage();
+    mSpareTileStateTable.clear();
+  }
+}
+
+// -----------------------------------------------------------------------------
+// reclaimJobImage
+// -----------------------------------------------------------------------------
+//  Keeps the image of a cancelled (or failed) job as the spare image. Any of
+//  its bands may be done or not, so the converted tiles are outdated and the
+//  copied ones are left as they were
+void ImageData::reclaimJobImage(ConversionJob *ioJob)
+{
+  if (ioJob->image.size() != mQImage->size() || ioJob->image.format() != mQImage->format())
+    return;
+  for (size_t i = 0; i < ioJob->tileTable.size(); i++)
+    if (ioJob->tileTable[i] && ioJob->tileStateTable[i] == TILE_STATE_CURRENT)
+      ioJob->tileStateTable[i] = TILE_STATE_OUTDATED;
+  mSpareImage.swap(ioJob->image);
+  mSpareTileStateTable.swap(ioJob->tileStateTable);
+}
+
+// -----------------------------------------------------------------------------
+// cancelConversion
+// -----------------------------------------------------------------------------
+//  The running job stops at its next band. It is not waited for : it works on
+//  its own image, frame and table (see startConversionJob()), and the
+//  cancelled jobs are never reported
+void ImageData::cancelConversion()
+{
+  (*mGeneration)++;
+  mConversionWatcher.setFuture(QFuture<bool>());
+  mConversionJob.reset();
+}
+
+// -----------------------------------------------------------------------------
+// runConversion
+// -----------------------------------------------------------------------------
+//  Runs in a worker thread. The bands (up to CONVERSION_BAND_HEIGHT rows of a
+//  run of tiles) are done in parallel and the generation is checked before
+//  each band, so a cancelled job stops within one band
+bool ImageData::runConversion(ConversionJob &ioJob)
+{
+  std::atomic<bool> failed(false);
+  QtConcurrent::blockingMap(ioJob.bands, [&](const std::pair<QRect, bool> &inBand)
+  {
+    if (failed || ioJob.generation != *ioJob.currentGeneration)
+    {
+      failed = true;
+      return;
+    }
+    if (inBand.second)
+      copyRect(inBand.first, ioJob.source, ioJob.params);
+    else if (convertRect(inBand.first, ioJob.params) == false)
+      failed = true;
+  });
+  ioJob.source = QImage();    // Not shared any more (see updateColorTable())
+  return failed == false && ioJob.generation == *ioJob.currentGeneration;
+}
+
+// -----------------------------------------------------------------------------
+// copyRect
+// -----------------------------------------------------------------------------
+//  Copies inRect of inSrc (of the same size and format) to the target of inParams
+void  ImageData::copyRect(const QRect &inRect, const QImage &inSrc, const ConversionParams &inParams)
+{
+  size_t  bytesPerPixel = (size_t )inSrc.depth() / 8;
+  size_t  offset = inRect.left() * bytesPerPixel;
+  for (int y = inRect.top(); y <= inRect.bottom(); y++)
+    memcpy(inParams.dstBits + (size_t )y * inParams.dstBytesPerLine + offset,
+           inSrc.constScanLine(y) + offset, inRect.width() * bytesPerPixel);
+}
+
+// -----------------------------------------------------------------------------
+// convertRect
+// -----------------------------------------------------------------------------
+bool  ImageData::convertRect(const QRect &inRect, const ConversionParams &inParams)
+{
+  if (inParams.displayType == DISPLAY_TYPE_MONO)
+    return convertMonoRect(inRect, inParams);
+  if (inParams.displayType == DISPLAY_TYPE_MONO_RGB)
+    return convertMonoRgbRect(inRect, inParams);
+  if (inParams.displayType == DISPLAY_TYPE_COLOR)
+    return convertColorRect(inRect, inParams);
+  return false;
+}
+
+// -----------------------------------------------------------------------------
+// convertMonoRect
+// -----------------------------------------------------------------------------
+//  Source values -> color table indexes (Format_Indexed8)
+bool  ImageData::convertMonoRect(const QRect &inRect, const ConversionParams &inParams)
+{
+  const uint8_t *table = inParams.indexTable;
+  unsigned int  tableSize = inParams.indexTableSize;
+  const ImageFormat &format = inParams.format;
+  if (format.type().isPacked())
+  {
+    // 1 and 4-bit pixels are expanded to the indexes directly (the source
+    // stays packed, 1 / 8 of the display image for a mask)
+    bool  lsbFirst = format.type().descriptor().isLsbFirst;
+    bool  is1Bit = (format.type().bitsPerComponent() == 1);
+    for (int y = inRect.top(); y <= inRect.bottom(); y++)
+    {
+      const uint8_t *src = format.linePtrFast(inParams.buffer, y);
+      uint8_t *dst = inParams.dstBits + (size_t )inParams.dstBytesPerLine * y + inRect.x();
+      if (is1Bit)
+        PixelKernels::expand1To8(src, inRect.x(), lsbFirst, table, dst, inRect.width());
+      else
+        PixelKernels::expand4To8(src, inRect.x(), lsbFirst, table, dst, inRect.width());
+    }
+    return true;
+  }
+  if (format.type().bitsPerComponent() > 16)
+  {
+    // 24 to 56-bit values (the odd widths are not aligned to their size)
+    const ImageType::Descriptor &desc = format.type().descriptor();
+    for (int y = inRect.top(); y <= inRect.bottom(); y++)
+    {
+      const uint8_t *src = format.linePtrFast(inParams.buffer, y) +
+                           (size_t )inRect.x() * format.pixelStep();
+      uint8_t *dst = inParams.dstBits + (size_t )inParams.dstBytesPerLine * y + inRect.x();
+      PixelKernels::windowWideTo8(src, desc.bytesPerComponent, desc.isSigned,
+                                  inParams.wideWindowLow, inParams.wideWindowShift,
+                                  dst, inRect.width());
+    }
+    return true;
+  }
+
+  PixelRange<uint8_t, 1> dst = PixelRange<uint8_t, 1>(
+          inParams.dstBits, format.width(), format.height(),
+          inParams.dstBytesPerLine).subRange(inRect.x(), inRect.y(), inRect.width(), inRect.height());
+  if (format.type().sizeOfData() == 1)
+  {
+    PixelRange<const uint8_t, 1> src(format, (const uint8_t *)inParams.buffer);
+    if (src.isValid() == false)
+      return false;
+    src = src.subRange(inRect.x(), inRect.y(), inRect.width(), inRect.height());
+    bool  isIdentity = inParams.indexTableIsIdentity;
+    if (format.type().isSigned())
+      transformRows(src, dst, [table, isIdentity](PixelRowSpan<const uint8_t, 1> inSrc,
+                                                  PixelRowSpan<uint8_t, 1> outDst)
+      {
+        // The table of an identity window is not needed after the offset
+        PixelKernels::offsetSigned8(inSrc.data(), outDst.data(), inSrc.width());
+        if (isIdentity == false)
+          PixelKernels::applyLUT8To8(outDst.data(), table, outDst.data(), inSrc.width());
+      });
+    else if (isIdentity)
+      transformRows(src, dst, [](PixelRowSpan<const uint8_t, 1> inSrc,
+                                 PixelRowSpan<uint8_t, 1> outDst)
+      {
+        memcpy(outDst.data(), inSrc.data(), inSrc.width());
+      });
+    else
+      transformRows(src, dst, [table](PixelRowSpan<const uint8_t, 1> inSrc,
+                                      PixelRowSpan<uint8_t, 1> outDst)
+      {
+        PixelKernels::applyLUT8To8(inSrc.data(), table, outDst.data(), inSrc.width());
+      });
+  }
+  else
+  {
+    PixelRange<const uint16_t, 1> src(format, (const uint16_t *)inParams.buffer);
+    if (src.isValid() == false)
+      return false;
+    src = src.subRange(inRect.x(), inRect.y(), inRect.width(), inRect.height());
+    int           narrowShift = inParams.indexNarrowShift;
+    unsigned int  valueShift = inParams.valueShift;
+    unsigned int  bitWidth = format.type().bitsPerComponent();
+    if (format.type().isSigned())
+      transformRows(src, dst, [table, tableSize, bitWidth, valueShift](
+                                PixelRowSpan<const uint16_t, 1> inSrc, PixelRowSpan<uint8_t, 1> outDst)
+      {
+        // Offset in chunks that stay in L1 between the two passes
+        uint16_t  offsetValues[SIGNED_OFFSET_CHUNK_SIZE];
+        for (size_t x = 0; x < inSrc.width(); x += SIGNED_OFFSET_CHUNK_SIZE)
+        {
+          size_t  num = inSrc.width() - x < SIGNED_OFFSET_CHUNK_SIZE ?
+                        inSrc.width() - x : SIGNED_OFFSET_CHUNK_SIZE;
+          PixelKernels::offsetSigned16(inSrc.data() + x, bitWidth, valueShift, offsetValues, num);
+          PixelKernels::applyLUT16To8(offsetValues, table, tableSize, outDst.data() + x, num);
+        }
+      });
+    else if (narrowShift >= 0)
+      transformRows(src, dst, [narrowShift](PixelRowSpan<const uint16_t, 1> inSrc,
+                                            PixelRowSpan<uint8_t, 1> outDst)
+      {
+        PixelKernels::shiftNarrow16To8(inSrc.data(), (unsigned int )narrowShift,
+                                       outDst.data(), inSrc.width());
+      });
+    else
+      transformRows(src, dst, [table, tableSize, valueShift](PixelRowSpan<const uint16_t, 1> inSrc,
+                                                             PixelRowSpan<uint8_t, 1> outDst)
+      {
+        PixelKernels::applyLUT16To8(inSrc.data(), table, tableSize, outDst.data(), inSrc.width(),
+                                    valueShift);
+      });
+  }
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// convertMonoRgbRect
+// -----------------------------------------------------------------------------
+//  9 to 16-bit source values -> RGB32 colors (Format_RGB32)
+bool  ImageData::convertMonoRgbRect(const QRect &inRect, const ConversionParams &inParams)
+{
+  const uint32_t *table = inParams.rgbTable;
+  unsigned int  tableSize = inParams.rgbTableSize;
+  const ImageFormat &format = inParams.format;
+  PixelRange<const uint16_t, 1> src(format, (const uint16_t *)inParams.buffer);
+  if (src.isValid() == false || tableSize == 0)
+    return false;
+  src = src.subRange(inRect.x(), inRect.y(), inRect.width(), inRect.height());
+  PixelRange<uint32_t, 1> dst = PixelRange<uint32_t, 1>(
+          (uint32_t *)inParams.dstBits, format.width(), format.height(),
+          inParams.dstBytesPerLine).subRange(inRect.x(), inRect.y(), inRect.width(), inRect.height());
+  unsigned int  valueShift = inParams.valueShift;
+  unsigned int  bitWidth = format.type().bitsPerComponent();
+  if (format.type().isSigned())
+    transformRows(src, dst, [table, tableSize, bitWidth, valueShift](
+                              PixelRowSpan<const uint16_t, 1> inSrc, PixelRowSpan<uint32_t, 1> outDst)
+    {
+      uint16_t  offsetValues[SIGNED_OFFSET_CHUNK_SIZE];
+      for (size_t x = 0; x < inSrc.width(); x += SIGNED_OFFSET_CHUNK_SIZE)
+      {
+        size_t  num = inSrc.width() - x < SIGNED_OFFSET_CHUNK_SIZE ?
+                      inSrc.width() - x : SIGNED_OFFSET_CHUNK_SIZE;
+        PixelKernels::offsetSigned16(inSrc.data() + x, bitWidth, valueShift, offsetValues, num);
+        PixelKernels::applyLUT16(offsetValues, table, tableSize, outDst.data() + x, num);
+      }
+    });
+  else
+    transformRows(src, dst, [table, tableSize, valueShift](PixelRowSpan<const uint16_t, 1> inSrc,
+                                                           PixelRowSpan<uint32_t, 1> outDst)
+    {
+      PixelKernels::applyLUT16(inSrc.data(), table, tableSize, outDst.data(), inSrc.width(),
+                               valueShift);
+    });
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// convertColorRect
+// -----------------------------------------------------------------------------
+//  8-bit RGB / BGR (with or without alpha) -> Format_RGB32
+bool  ImageData::convertColorRect(const QRect &inRect, const ConversionParams &inParams)
+{
+  unsigned int  pixelStep, r, g, b;
+  if (getColorLayout(inParams.format, &pixelStep, &r, &g, &b) == false)
+    return false;
+  for (int y = inRect.top(); y <= inRect.bottom(); y++)
+  {
+    const uint8_t *src = inParams.format.linePtrFast(inParams.buffer, y) +
+                         (size_t )inRect.x() * pixelStep;
+    uint32_t  *dst = (uint32_t *)(inParams.dstBits + (size_t )inParams.dstBytesPerLine * y) +
+                     inRect.x();
+    PixelKernels::packRGB32(src, pixelStep, r, g, b, dst, inRect.width());
+  }
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// markAllTilesDirty
+// -----------------------------------------------------------------------------
+//  Also cancels the running conversion (of the old data), unless the display
+//  has been waiting longer than CONVERSION_WAIT_TIME_MAX. Then the job is left
+//  to finish so that a continuous stream of changes can't starve the display
+void  ImageData::markAllTilesDirty()
+{
+  mTileDirtyTable.assign(mTileDirtyTable.size(), true);
+  mDirtyTileNum = mTileDirtyTable.size();
+  mModifiedCount++;
+  if (mConversionClock.isValid() &&
+      mConversionClock.elapsed() - mWaitStartTime < CONVERSION_WAIT_TIME_MAX)
+    (*mGeneration)++;
+}
+
+// -----------------------------------------------------------------------------
+// getVisibleImageRect
+// -----------------------------------------------------------------------------
+//  The areas the widgets show (or may show soon), merged
+QRect ImageData::getVisibleImageRect() const
+{
+  QRect rect;
+  for (auto it = mWidgetList.begin(); it != mWidgetList.end(); it++)
+    rect |= (*it)->getVisibleImageRect();
+  return rect;
+}
+
+// -----------------------------------------------------------------------------
+// getTileRect
+// -----------------------------------------------------------------------------
+QRect ImageData::getTileRect(size_t inIndex) const
+{
+  QRect rect((int )(inIndex % mTileXNum * TILE_SIZE), (int )(inIndex / mTileXNum * TILE_SIZE),
+             (int )TILE_SIZE, (int )TILE_SIZE);
+  return rect.intersected(mQImage->rect());
+}
+
+// -----------------------------------------------------------------------------
+// addConversionBands
+// -----------------------------------------------------------------------------
+//  The tiles of inTileTable are merged into runs along the rows (to keep the
+//  kernel rows long) and cut into bands of CONVERSION_BAND_HEIGHT rows
+void  ImageData::addConversionBands(const std::vector<bool> &inTileTable, bool inCopyFlag,
+                                    ConversionJob *ioJob) const
+{
+  for (unsigned int ty = 0; ty < mTileYNum; ty++)
+  {
+    unsigned int  tx = 0;
+    while (tx < mTileXNum)
+    {
+      if (inTileTable[ty * mTileXNum + tx] == false)
+      {
+        tx++;
+        continue;
+      }
+      unsigned int  runStart = tx;
+      while (tx < mTileXNum && inTileTable[ty * mTileXNum + tx])
+        tx++;
+      QRect runRect = getTileRect(ty * mTileXNum + runStart).united(
+                      getTileRect(ty * mTileXNum + tx - 1));
+      for (int y = runRect.top(); y <= runRect.bottom(); y += CONVERSION_BAND_HEIGHT)
+      {
+        int height = std::min(CONVERSION_BAND_HEIGHT, runRect.bottom() + 1 - y);
+        ioJob->bands.push_back(std::make_pair(QRect(runRect.left(), y, runRect.width(), height),
+                                              inCopyFlag));
+      }
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+// getDisplayType
+// -----------------------------------------------------------------------------
+ImageData::DisplayType  ImageData::getDisplayType() const
+{
+  unsigned int  pixelStep, r, g, b;
+  if (getColorLayout(mImageFormat, &pixelStep, &r, &g, &b))
+    return DISPLAY_TYPE_COLOR;
+  unsigned int  bitWidth = getDisplayBitWidth();
+  if (bitWidth == 0)
+    return DISPLAY_TYPE_NOT_SUPPORTED;
+  if (bitWidth > 8 && bitWidth <= 16 && mColorMapIndex != ColorMap::CMI_NOT_SPECIFIED &&
+      qAlpha(mOverlayColor) == 0)
+    return DISPLAY_TYPE_MONO_RGB;
+  return DISPLAY_TYPE_MONO;
+}
+
+// -----------------------------------------------------------------------------
+// getDisplayBitWidth
+// -----------------------------------------------------------------------------
+//  Returns the bit width of the source values that can be displayed through
+//  the index table (0 if not supported)
+unsigned int  ImageData::getDisplayBitWidth() const
+{
+  const ImageType &type = mImageFormat.type();
+  if (type.isValid() == false)
+    return 0;
+  unsigned int  bitWidth = type.bitsPerComponent();
+  if (bitWidth > 16)    // 24 to 56-bit integers, no table (see updateIndexTable())
+  {
+    if (type.isFloat() || type.isPlanar() || type.isPacked() || type.componentsPerPixel() != 1 ||
+        type.sizeOfData() < 3 || type.sizeOfData() > 7 ||
+        mImageFormat.pixelStep() != type.sizeOfData())
+      return 0;
+    ImageType::EndianType endian = type.endianType() == ImageType::ENDIAN_TYPE_HOST ?
+                                   ImageType::getHostEndian() : type.endianType();
+    if (endian != ImageType::ENDIAN_LITTLE)   // windowWideTo8() reads little endian
+      return 0;
+    return bitWidth;
+  }
+  if (type.isPacked())  // 1 and 4-bit mono only (see convertMonoRect())
+  {
+    if (type.isSigned() || type.isPlanar() || type.componentsPerPixel() != 1 ||
+        type.descriptor().isCsi2Packed || (bitWidth != 1 && bitWidth != 4))
+      return 0;
+    return bitWidth;
+  }
+  if (bitWidth == 0 || type.componentsPerPixel() != 1)   // No 16-bit color display
+    return 0;
+  if (type.sizeOfData() != 1 && type.sizeOfData() != 2)
+    return 0;
+  if (type.sizeOfData() == 2 &&
+      type.endianType() != ImageType::ENDIAN_TYPE_HOST &&
+      type.endianType() != ImageType::getHostEndian())
+    return 0;
+  return bitWidth;
+}
+
+// -----------------------------------------------------------------------------
+// getColorLayout
+// -----------------------------------------------------------------------------
+//  Returns the pixel step and the byte offsets of R, G and B for the pixel
+//  aligned 8-bit color types (false for the others)
+bool  ImageData::getColorLayout(const ImageFormat &inFormat, unsigned int *outPixelStep,
+                                unsigned int *outR, unsigned int *outG, unsigned int *outB)
+{
+  const ImageType &type = inFormat.type();
+  if (type.isValid() == false || type.isSigned() || type.isPacked() || type.isPlanar())
+    return false;
+  if (type.sizeOfData() != 1 || type.dataType() != ImageType::DATA_TYPE_8BIT)
+    return false;
+
+  const ImageType::Descriptor &desc = type.descriptor();
+  if (desc.redIndex < 0 || desc.greenIndex < 0 || desc.blueIndex < 0)
+    return false;
+  unsigned int  pixelStep = (unsigned int )inFormat.pixelStep();
+  if (pixelStep != type.componentsPerPixel())
+    return false;
+  *outPixelStep = pixelStep;
+  *outR = (unsigned int )desc.redIndex;
+  *outG = (unsigned int )desc.greenIndex;
+  *outB = (unsigned int )desc.blueIndex;
+  return true;
 }
 
 // -----------------------------------------------------------------------------
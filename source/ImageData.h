@@ -20,10 +20,18 @@
 #define QIV_IMAGE_DATA_H
 
 // Includes --------------------------------------------------------------------
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <vector>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
 #include <QImage>
 #include <QPainter>
+#include "ColorMap.h"
+#include "FramePresenter.h"
 #include "ImageFormat.h"
+#include "RenderCache.h"
 #include "ViewDataInterface.h"
 
 // -----------------------------------------------------------------------------
@@ -32,6 +40,27 @@
 class ImageData
 {
 public:
+  // Constants -----------------------------------------------------------------
+  const static unsigned int TILE_SIZE = 256;  // Conversion unit (pixels)
+  const static int  CONVERSION_BAND_HEIGHT = 64;      // Cancellation unit of the background conversion
+  const static int  CONVERSION_WAIT_TIME_MAX = 100;   // ms (see markAllTilesDirty())
+  const static size_t FRAME_POOL_SIZE = 3;            // Released frames kept for reuse
+  const static size_t FRAME_SLOT_NUM = 4;             // Publication slots (see getFrame())
+  const static size_t SIGNED_OFFSET_CHUNK_SIZE = 512; // Pixels offset at a time (see convertMonoRect())
+  const static size_t SPARE_IMAGE_SIZE_MAX = 16 * 1024 * 1024;  // Bytes kept while idle (see conversionFinished())
+
+  // A published frame. Never modified after it is published (the writers
+  // fill a new one and publish it), so a snapshot can be read from any
+  // thread without a lock for as long as it is held
+  struct Frame
+  {
+    ImageFormat   format;
+    std::unique_ptr<unsigned char[]>  buffer;
+    uint64_t      generation;       // Incremented for every published frame
+  };
+  typedef std::shared_ptr<const Frame>  FramePtr;
+  typedef std::shared_ptr<Frame>        PendingFramePtr;  // Being filled, not published yet
+
   // Constructors and Destructor -----------------------------------------------
   ImageData();
   virtual ~ImageData();
@@ -39,33 +68,203 @@ public:
   // Member functions ----------------------------------------------------------
   bool allocate(const ImageFormat &inFormat);
   bool copy(const void *inImagePtr, const ImageFormat &inFormat);
+  PendingFramePtr beginFrame(const ImageFormat &inFormat);
+  bool commitFrame(PendingFramePtr inFrame);
   bool check() const;
+  FramePtr getFrame() const;
 
-  void *getData() const;
+  const void *getData() const;
+  const QImage *getDisplayImage() const;
+  unsigned int getDisplayGeneration() const;
   const ImageFormat &getFormat() const;
+  bool getPixelValue(unsigned int inX, unsigned int inY, PixelValue *outValue) const;
+  bool getDisplayColor(unsigned int inX, unsigned int inY, QRgb *outColor) const;
+  void setColorMap(ColorMap::ColorMapIndex inIndex);
+  ColorMap::ColorMapIndex getColorMap() const;
+  void setOverlayColor(QRgb inColor);
+  QRgb getOverlayColor() const;
+  void setWindowLevel(double inWindow, double inLevel);
+  void getWindowLevel(double *outWindow, double *outLevel) const;
+  void resetWindowLevel();
+  double getWindowLevelRange() const;
+  void setBitWindow(unsigned int inLowBit);
+  void setSymmetricWindow(bool inFlag);
+  bool getSymmetricWindow() const;
 
   void setImageModifiedFlag(bool inFlag);
   bool getImageModifiedFlag() const;
 
-  virtual bool  update(bool inForceUpdate = false);
+  bool  startConversion();
+  bool  isConverting() const;
   void draw(QPainter &inPainter, const QRect &rect);
+  void draw(QPainter &inPainter, const QRectF &inTargetRect, const QRect &inSourceRect);
 
   void  addWidget(ViewDataInterface *inWidget);
   void  removeWidget(ViewDataInterface *inWidget);
   void  redrawAllWidgets();
+  void  redrawAllWidgets(const QRect &inDirtyRect);
+  FramePresenter *getPresenter();
+  std::shared_ptr<RenderCache> acquireRenderCache(const RenderCacheKey &inKey);
+
+  // Static Functions ----------------------------------------------------------
+  static void makeColorTable(ColorMap::ColorMapIndex inIndex, uint32_t *outTable);
 
 private:
   // Member variables ----------------------------------------------------------
-  ImageFormat   mImageFormat;
-  unsigned char *mImageBuffer;
-  bool  mImageModifiedFlag;
+  // The writers (any thread) only touch the frames. Everything else is the
+  // display side (GUI thread), which follows the published frame at syncFrame().
+  // The published frame is mFrameSlots[mPublishedSlot].frame : a reader pins
+  // the slot while it copies the pointer, the writers fill only the slots
+  // that are neither published nor pinned (see getFrame())
+  struct FrameSlot
+  {
+    std::shared_ptr<Frame>  frame;
+    mutable std::atomic<unsigned int> readerNum;
+  };
+  FrameSlot     mFrameSlots[FRAME_SLOT_NUM];
+  std::atomic<unsigned int> mPublishedSlot;
+  std::mutex    mWriterMutex;             // Serializes the writers (never taken by the readers)
+  std::vector<std::shared_ptr<Frame>> mFramePool;   // Released frames (mWriterMutex)
+  uint64_t      mFrameGeneration;         // Of the last published frame (mWriterMutex)
+  FramePtr      mDisplayFrame;            // The frame the display side follows
+  ImageFormat   mImageFormat;             // mDisplayFrame->format
+  std::vector<bool> mTileDirtyTable;    // Tiles waiting for the conversion
+  unsigned int  mTileXNum, mTileYNum;
+  size_t        mDirtyTileNum;
+
+  // Contents of a tile of the spare image (see startConversion())
+  enum TileState
+  {
+    TILE_STATE_CURRENT  = 0,    // Same as mQImage
+    TILE_STATE_OUTDATED,        // A previous conversion (any data / table)
+    TILE_STATE_UNDEFINED        // Never written
+  };
+
+  // Mono sources are displayed as Format_Indexed8 : the source values are
+  // mapped to 8-bit indexes (window / level) and the colormap is the color
+  // table of mQImage. Color sources are displayed as Format_RGB32, and so are
+  // the 9 to 16-bit mono sources with a colormap, through a table of one
+  // RGB32 entry per source value (the colormap is not cut to 256 colors).
+  // Those are shown in the colormap of this object, even by a view that has
+  // its own (see ImageView::setColorMap())
+  enum DisplayType
+  {
+    DISPLAY_TYPE_NOT_SUPPORTED  = 0,
+    DISPLAY_TYPE_MONO,
+    DISPLAY_TYPE_MONO_RGB,
+    DISPLAY_TYPE_COLOR
+  };
 
   QImage  *mQImage;
+  DisplayType mDisplayType;
+  ColorMap::ColorMapIndex mColorMapIndex;   // CMI_NOT_SPECIFIED : grayscale
+  QRgb    mOverlayColor;                    // Alpha != 0 : overlay (see setOverlayColor())
+  double  mWindow;    // Number of source values mapped to the full display range
+  double  mLevel;     // Center of the window
+  bool    mSymmetricWindowFlag;   // Level of the signed sources fixed to 0
+  struct IndexTableParams
+  {
+    unsigned int  valueNum;
+    double        gain;
+    int           offset;
+  } mIndexTableParams;                      // Parameters of mIndexTable
+  std::vector<unsigned char>  mDisplayRgbTable;
+  std::vector<uint8_t>        mIndexTable;  // Color table index, one entry per source value
+  std::vector<uint32_t>       mRgbTable;    // RGB32, one entry per source value (DISPLAY_TYPE_MONO_RGB)
+  bool    mIndexTableIsIdentity;            // 8-bit source with the default window
+  int     mIndexNarrowShift;                // >= 0 : the table is (value >> this), no lookup needed
+  int64_t       mWideWindowLow;             // Window of the values wider than 16 bits (no table),
+  unsigned int  mWideWindowShift;           // see windowWideTo8()
   std::vector<ViewDataInterface *>  mWidgetList;
+  FramePresenter  mPresenter;
+  std::mutex    mNotificationMutex;
+  QRect         mPendingDirtyRect;      // Requested since the last present (mNotificationMutex)
+  QRect         mDisplayDirtyRect;      // Not notified to the widgets yet (GUI thread)
+  unsigned int    mDisplayGeneration;   // Incremented when mQImage is changed
+  std::vector<std::weak_ptr<RenderCache>> mRenderCacheList;   // Shared by the views
+
+  // Everything convertRect() needs, so that a background job can work on a
+  // copy that is not affected by the later parameter changes
+  struct ConversionParams
+  {
+    ImageFormat   format;
+    const unsigned char *buffer;
+    DisplayType   displayType;
+    const uint8_t *indexTable;
+    unsigned int  indexTableSize;
+    bool          indexTableIsIdentity;
+    const uint32_t *rgbTable;               // DISPLAY_TYPE_MONO_RGB
+    unsigned int  rgbTableSize;
+    int           indexNarrowShift;         // >= 0 : shiftNarrow16To8() instead of the table
+    unsigned int  valueShift;               // Of the MSB aligned data (table index = value >> this)
+    int64_t       wideWindowLow;            // Values wider than 16 bits : windowWideTo8()
+    unsigned int  wideWindowShift;
+    unsigned char *dstBits;
+    int           dstBytesPerLine;
+  };
+
+  // Background conversion. The job converts into its own image, which is
+  // swapped with mQImage when it completes (paint always sees a complete one).
+  // The tiles it doesn't convert are copied from source where needed
+  struct ConversionJob
+  {
+    unsigned int  generation;       // Cancelled when *currentGeneration is changed
+    std::shared_ptr<const std::atomic<unsigned int>>  currentGeneration;   // mGeneration
+    unsigned int  modifiedCount;    // mModifiedCount when started
+    FramePtr      frame;            // Keeps params.buffer alive
+    std::vector<uint8_t>  indexTable;
+    std::vector<uint32_t> rgbTable;
+    std::vector<bool>     tileTable;          // The tiles converted
+    std::vector<bool>     copyTable;          // The tiles copied from source
+    std::vector<std::pair<QRect, bool>> bands;   // Copied (true) or converted
+    std::vector<uint8_t>  tileStateTable;     // TileState of image when started
+    QImage        source;           // mQImage when started (released by the job)
+    QImage        image;
+    ConversionParams  params;
+  };
+  std::shared_ptr<ConversionJob>  mConversionJob;   // In flight (nullptr : none)
+  QFutureWatcher<bool>      mConversionWatcher;
+  std::shared_ptr<std::atomic<unsigned int>> mGeneration;   // Shared with the jobs
+  std::atomic<unsigned int> mModifiedCount;       // Incremented by markAllTilesDirty()
+  QElapsedTimer mConversionClock;                 // Never restarted (read from any thread)
+  std::atomic<qint64> mWaitStartTime;             // mConversionClock time since when the display waits
+  QImage        mSpareImage;                      // Reused by the next job
+  std::vector<uint8_t>  mSpareTileStateTable;     // TileState of mSpareImage
 
   // Member functions ----------------------------------------------------------
+  void  releaseFrame(std::shared_ptr<Frame> &&inFrame);
+  void  syncFrame();
   void  parameterModified();
+  void  createDisplayImage();
+  void  colorMapModified();
+  void  presentAllWidgets();
+  void  notifyAllWidgets(uint64_t inFrameGeneration);
+  bool  updateIndexTable();
+  bool  updateRgbTable(unsigned int inValueNum, double inGain, int inOffset);
+  void  updateColorTable();
+  ConversionParams  getConversionParams(QImage *inDstImage) const;
+  bool  startConversionJob();
+  void  conversionFinished();
+  void  cancelConversion();
+  void  markAllTilesDirty();
+  QRect getVisibleImageRect() const;
+  QRect getTileRect(size_t inIndex) const;
+  void  addConversionBands(const std::vector<bool> &inTileTable, bool inCopyFlag,
+                           ConversionJob *ioJob) const;
+  void  reclaimJobImage(ConversionJob *ioJob);
+  DisplayType   getDisplayType() const;
+  unsigned int  getDisplayBitWidth() const;
   void  disposeQImage();
+
+  // Static Functions ----------------------------------------------------------
+  static bool runConversion(ConversionJob &ioJob);
+  static void copyRect(const QRect &inRect, const QImage &inSrc, const ConversionParams &inParams);
+  static bool convertRect(const QRect &inRect, const ConversionParams &inParams);
+  static bool convertMonoRect(const QRect &inRect, const ConversionParams &inParams);
+  static bool convertMonoRgbRect(const QRect &inRect, const ConversionParams &inParams);
+  static bool convertColorRect(const QRect &inRect, const ConversionParams &inParams);
+  static bool getColorLayout(const ImageFormat &inFormat, unsigned int *outPixelStep,
+                             unsigned int *outR, unsigned int *outG, unsigned int *outB);
 };
 
 #endif //QIV_IMAGE_DATA_H
@@ -23,6 +23,13 @@
 #include <strings.h>
 #include "ImageFormat.h"
 
+// Local static functions ------------------------------------------------------
+static uint64_t readRawComponent(const unsigned char *inPtr, size_t inSize,
+                                 bool inIsBigEndian);
+static uint64_t readPackedBits(const unsigned char *inPtr, size_t inBitPos,
+                               unsigned int inBits, bool inIsLsbFirst);
+static bool getCsi2Group(unsigned int inBits, size_t *outSampleNum, size_t *outByteNum);
+static int64_t extendSign(uint64_t inRaw, unsigned int inBits);
 
 // -----------------------------------------------------------------------------
 // ImageFormat
@@ -63,9 +70,11 @@ ImageFormat::~ImageFormat()
 // -----------------------------------------------------------------------------
 bool ImageFormat::isValid() const
 {
-  if (mWidth == 0 || mHeight == 0 || mBufferSize == 0 || mPixelStep == 0 ||
+  if (mWidth == 0 || mHeight == 0 || mBufferSize == 0 ||
       mLineStep == 0 || mChannelStep == 0 || mPixelAreaSize == 0)
     return false;
+  if (mPixelStep == 0 && mImageType.isPacked() == false)   // Packed pixels have no byte step
+    return false;
 
   return mImageType.isValid();
 }
@@ -134,6 +143,16 @@ size_t ImageFormat::lineStep() const
   return mLineStep;
 }
 
+// -----------------------------------------------------------------------------
+// lineStride
+// -----------------------------------------------------------------------------
+//  The address difference from line y to line y + 1 : negative for bottom-up
+//  images (e.g. DIBs), which are read in place as top-down ones
+ptrdiff_t ImageFormat::lineStride() const
+{
+  return mIsBottomUp ? -(ptrdiff_t )mLineStep : (ptrdiff_t )mLineStep;
+}
+
 // -----------------------------------------------------------------------------
 // channelStep
 // -----------------------------------------------------------------------------
@@ -244,6 +263,138 @@ const void *ImageFormat::pixelPtr(const void *inBufferPtr) const
   return getPixelPtr(*this, inBufferPtr);
 }
 
+// -----------------------------------------------------------------------------
+// getPixelValue
+// -----------------------------------------------------------------------------
+bool ImageFormat::getPixelValue(const void *inBufferPtr, unsigned int inX, unsigned int inY,
+                                PixelValue *outValue) const
+{
+  if (inBufferPtr == nullptr || isValid() == false)
+    return false;
+  if (inX >= mWidth || inY >= mHeight)
+    return false;
+  // The line interleaved buffers have no layout here (the lines of the
+  // components are not described) and the macro pixels (YUV) have no value
+  // of their own : both are rejected
+  if (mImageType.bufferType() >= ImageType::BUFFER_TYPE_LINE_INTERLEAVE_ALIGNED ||
+      mImageType.hasMacroPixelStructure())
+    return false;
+  if (mImageType.isPacked())
+    return getPackedPixelValue(inBufferPtr, inX, inY, outValue);
+
+  size_t  size = mImageType.sizeOfData();
+  if (size == 0 || size > sizeof(uint64_t))
+    return false;
+
+  ImageType::DataType dataType = mImageType.dataType();
+  bool  isBigEndian = (mImageType.endianType() == ImageType::ENDIAN_BIG);
+  if (mImageType.endianType() == ImageType::ENDIAN_TYPE_NOT_SPECIFIED)
+    isBigEndian = (ImageType::getHostEndian() == ImageType::ENDIAN_BIG);
+
+  outValue->componentNum = mImageType.componentsPerPixel();
+  if (outValue->componentNum > PixelValue::MAX_COMPONENTS)
+    outValue->componentNum = PixelValue::MAX_COMPONENTS;
+  outValue->isFloat = (dataType == ImageType::DATA_TYPE_FLOAT ||
+                       dataType == ImageType::DATA_TYPE_DOUBLE);
+
+  const unsigned char *basePtr = (const unsigned char *)inBufferPtr;
+  for (unsigned int i = 0; i < outValue->componentNum; i++)
+  {
+    const unsigned char *ptr;
+    if (mImageType.isPlanar())
+      ptr = basePtr + calculatePixelOffset(*this, inX, inY, i);
+    else
+      ptr = basePtr + calculatePixelOffset(*this, inX, inY) + size * i;
+
+    uint64_t  raw = readRawComponent(ptr, size, isBigEndian);
+    if (dataType == ImageType::DATA_TYPE_FLOAT)
+    {
+      uint32_t  bits = (uint32_t )raw;
+      float     value;
+      memcpy(&value, &bits, sizeof(value));
+      outValue->floatValue[i] = value;
+      outValue->intValue[i] = (int64_t )value;
+      continue;
+    }
+    if (dataType == ImageType::DATA_TYPE_DOUBLE)
+    {
+      double  value;
+      memcpy(&value, &raw, sizeof(value));
+      outValue->floatValue[i] = value;
+      outValue->intValue[i] = (int64_t )value;
+      continue;
+    }
+
+    unsigned int  bits = mImageType.bitsPerComponent();   // e.g. 12-bit in 16-bit words
+    if (bits == 0 || bits > size * 8)
+      bits = (unsigned int )(size * 8);
+    raw >>= mImageType.descriptor().valueShift;
+    if (bits < 64)
+      raw &= ((uint64_t )1 << bits) - 1;    // The unused bits of the container
+    int64_t value = mImageType.isSigned() ? extendSign(raw, bits) : (int64_t )raw;
+    outValue->intValue[i] = value;
+    outValue->floatValue[i] = (double )value;
+  }
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// getPackedPixelValue
+// -----------------------------------------------------------------------------
+//  The packed components are a bit stream from the start of each line, in
+//  the bit order of the type (e.g. 1-bit masks MSB first, Mono10p LSB first).
+//  The CSI-2 ones come in groups : the 8 high bits of each component, then
+//  the low bits of all of them LSB first (RAW10 : 4 in 5 bytes, RAW12 : 2 in
+//  3 bytes, RAW14 : 4 in 7 bytes)
+bool ImageFormat::getPackedPixelValue(const void *inBufferPtr, unsigned int inX, unsigned int inY,
+                                      PixelValue *outValue) const
+{
+  const ImageType::Descriptor &desc = mImageType.descriptor();
+  unsigned int  bits = desc.bitsPerComponent;
+  if (desc.isFloat || bits == 0 || bits > 64)
+    return false;
+  size_t  groupSampleNum = 0, groupByteNum = 0;
+  if (desc.isCsi2Packed && getCsi2Group(bits, &groupSampleNum, &groupByteNum) == false)
+    return false;
+
+  outValue->componentNum = desc.componentsPerPixel;
+  if (outValue->componentNum > PixelValue::MAX_COMPONENTS)
+    outValue->componentNum = PixelValue::MAX_COMPONENTS;
+  outValue->isFloat = false;
+  for (unsigned int i = 0; i < outValue->componentNum; i++)
+  {
+    // The component's position in its line
+    const unsigned char *line;
+    size_t  index;
+    if (desc.isPlanar)
+    {
+      line = linePtrFast(inBufferPtr, inY, i);
+      index = inX;
+    }
+    else
+    {
+      line = linePtrFast(inBufferPtr, inY);
+      index = (size_t )inX * desc.componentsPerPixel + i;
+    }
+
+    uint64_t  raw;
+    if (desc.isCsi2Packed)
+    {
+      const unsigned char *group = line + index / groupSampleNum * groupByteNum;
+      size_t  n = index % groupSampleNum;
+      unsigned int  lowBits = bits - 8;
+      raw = ((uint64_t )group[n] << lowBits) |
+            readPackedBits(group + groupSampleNum, n * lowBits, lowBits, true);
+    }
+    else
+      raw = readPackedBits(line, index * bits, bits, desc.isLsbFirst);
+    int64_t value = desc.isSigned ? extendSign(raw, bits) : (int64_t )raw;
+    outValue->intValue[i] = value;
+    outValue->floatValue[i] = (double )value;
+  }
+  return true;
+}
+
 // -----------------------------------------------------------------------------
 // invalidate
 // -----------------------------------------------------------------------------
@@ -260,6 +411,32 @@ void ImageFormat::invalidate()
   mLineStep       = 0;
   mChannelStep    = 0;
   mPixelAreaSize  = 0;
+  mPlaneOffsetTable.clear();
+}
+
+// -----------------------------------------------------------------------------
+// operator==
+// -----------------------------------------------------------------------------
+//  The plane offsets follow from the other members
+bool ImageFormat::operator==(const ImageFormat &inFormat) const
+{
+  return mImageType == inFormat.mImageType &&
+         mWidth == inFormat.mWidth &&
+         mHeight == inFormat.mHeight &&
+         mIsBottomUp == inFormat.mIsBottomUp &&
+         mBufferSize == inFormat.mBufferSize &&
+         mHeaderOffset == inFormat.mHeaderOffset &&
+         mPixelStep == inFormat.mPixelStep &&
+         mLineStep == inFormat.mLineStep &&
+         mChannelStep == inFormat.mChannelStep;
+}
+
+// -----------------------------------------------------------------------------
+// operator!=
+// -----------------------------------------------------------------------------
+bool ImageFormat::operator!=(const ImageFormat &inFormat) const
+{
+  return !(*this == inFormat);
 }
 
 // -----------------------------------------------------------------------------
@@ -299,18 +476,22 @@ void ImageFormat::set(unsigned int inWidth, unsigned int inHeight,
   if (inPixelStep != 0)
     mPixelStep = inPixelStep; // TODO: Add a sanity check here...
   else
+    mPixelStep = mImageType.descriptor().bytesPerPixel;   // 0 : packed or macro pixel
+  if (inLineStep != 0)
+    mLineStep = inLineStep; // TODO: Add a sanity check here...
+  else if (mPixelStep == 0 && mImageType.isPacked())
   {
-    if (mImageType.isPacked() || mImageType.hasMacroPixelStructure())
-      mPixelStep = 0;
+    // Packed lines start at a byte boundary (CSI-2 ones at a group boundary)
+    size_t  sampleNum = mWidth;
+    if (mImageType.isPlanar() == false)
+      sampleNum *= mImageType.componentsPerPixel();
+    size_t  groupSampleNum, groupByteNum;
+    if (mImageType.descriptor().isCsi2Packed &&
+        getCsi2Group(mImageType.bitsPerComponent(), &groupSampleNum, &groupByteNum))
+      mLineStep = (sampleNum + groupSampleNum - 1) / groupSampleNum * groupByteNum;
     else
-    {
-      mPixelStep = mImageType.sizeOfData();
-      if (mImageType.isPlanar() == false)
-        mPixelStep *= mImageType.componentsPerPixel();
-    }
+      mLineStep = (mImageType.bitsPerComponent() * sampleNum + 7) / 8;
   }
-  if (inLineStep != 0)
-    mLineStep = inLineStep; // TODO: Add a sanity check here...
   else
     mLineStep = mPixelStep * mWidth;
   if (inChannelStep != 0)
@@ -327,6 +508,8 @@ void ImageFormat::set(unsigned int inWidth, unsigned int inHeight,
     mBufferSize = inBufferSize;
   else
     mBufferSize = mHeaderOffset + mPixelAreaSize;
+  //
+  updatePlaneOffsetTable();
 }
 
 // -----------------------------------------------------------------------------
@@ -353,6 +536,20 @@ void  ImageFormat::dump(const char *inLeadringStr)
   printf("%smPixelAreaSize  : %zu\n", inLeadringStr, mPixelAreaSize);
 }
 
+// -----------------------------------------------------------------------------
+// updatePlaneOffsetTable
+// -----------------------------------------------------------------------------
+void ImageFormat::updatePlaneOffsetTable()
+{
+  unsigned int  num = 1;
+  if (mImageType.isPlanar() && mImageType.componentsPerPixel() != 0)
+    num = mImageType.componentsPerPixel();
+
+  mPlaneOffsetTable.resize(num);
+  for (unsigned int i = 0; i < num; i++)
+    mPlaneOffsetTable[i] = calculatePlaneOffset(*this, i);
+}
+
 // -----------------------------------------------------------------------------
 // pixelPtr
 // -----------------------------------------------------------------------------
@@ -398,6 +595,8 @@ size_t ImageFormat::calculateLineOffsetFromPlaneOffset(
 {
   if (inY >= inFormat.mHeight)
     inY = inFormat.mHeight - 1;
+  if (inFormat.mIsBottomUp)
+    inY = inFormat.mHeight - 1 - inY;
   if (inY == 0)
     return inPlaneOffset;
   return inPlaneOffset + inFormat.mLineStep * inY;
@@ -459,3 +658,82 @@ size_t ImageFormat::calculatePixelOffset(
                               calculateLineOffset(inFormat, inY, inPlaneIndex),
                               inX);
 }
+
+// Local static functions ------------------------------------------------------
+// -----------------------------------------------------------------------------
+// readRawComponent
+// -----------------------------------------------------------------------------
+static uint64_t readRawComponent(const unsigned char *inPtr, size_t inSize,
+                                 bool inIsBigEndian)
+{
+  uint64_t  value = 0;
+
+  if (inIsBigEndian)
+  {
+    for (size_t i = 0; i < inSize; i++)
+      value = (value << 8) | inPtr[i];
+  }
+  else
+  {
+    for (size_t i = inSize; i > 0; i--)
+      value = (value << 8) | inPtr[i - 1];
+  }
+  return value;
+}
+
+// -----------------------------------------------------------------------------
+// readPackedBits
+// -----------------------------------------------------------------------------
+//  inBits (up to 64) from the bit inBitPos of a bit stream. LSB first : the
+//  stream starts at the low bit of the first byte and the first bits are the
+//  low bits of the value. MSB first : the other way around
+static uint64_t readPackedBits(const unsigned char *inPtr, size_t inBitPos,
+                               unsigned int inBits, bool inIsLsbFirst)
+{
+  uint64_t  value = 0;
+
+  for (unsigned int n = 0; n < inBits; )
+  {
+    unsigned int  offset = (unsigned int )(inBitPos % 8);
+    unsigned int  num = 8 - offset;
+    if (num > inBits - n)
+      num = inBits - n;
+    unsigned int  mask = (1u << num) - 1;
+    unsigned int  byte = inPtr[inBitPos / 8];
+    if (inIsLsbFirst)
+      value |= (uint64_t )((byte >> offset) & mask) << n;
+    else
+      value = (value << num) | ((byte >> (8 - offset - num)) & mask);
+    n += num;
+    inBitPos += num;
+  }
+  return value;
+}
+
+// -----------------------------------------------------------------------------
+// getCsi2Group
+// -----------------------------------------------------------------------------
+//  The components and bytes of a CSI-2 group (RAW8 to RAW14, the other
+//  widths up to 15 bits are grouped the same way)
+static bool getCsi2Group(unsigned int inBits, size_t *outSampleNum, size_t *outByteNum)
+{
+  if (inBits < 8 || inBits > 15)
+    return false;
+  size_t  num = 1;
+  while ((num * (inBits - 8)) % 8 != 0)
+    num++;
+  *outSampleNum = num;
+  *outByteNum = num * inBits / 8;
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// extendSign
+// -----------------------------------------------------------------------------
+//  inRaw is an inBits two's complement value (the higher bits are 0)
+static int64_t extendSign(uint64_t inRaw, unsigned int inBits)
+{
+  if (inBits == 0 || inBits >= 64 || (inRaw & ((uint64_t )1 << (inBits - 1))) == 0)
+    return (int64_t )inRaw;
+  return (int64_t )(inRaw | (~(uint64_t )0 << inBits));
+}
@@ -21,8 +21,26 @@
 #define QIV_IMAGE_FORMAT_H
 
 // Includes --------------------------------------------------------------------
+#include <cassert>
+#include <cstddef>
+#include <vector>
 #include "ImageType.h"
 
+// -----------------------------------------------------------------------------
+// PixelValue struct
+// -----------------------------------------------------------------------------
+struct  PixelValue
+{
+  // Constants -----------------------------------------------------------------
+  const static unsigned int MAX_COMPONENTS = 8;
+
+  // Member variables ----------------------------------------------------------
+  unsigned int  componentNum;
+  bool          isFloat;
+  int64_t       intValue[MAX_COMPONENTS];
+  double        floatValue[MAX_COMPONENTS];
+};
+
 // -----------------------------------------------------------------------------
 // ImageFormat class
 // -----------------------------------------------------------------------------
@@ -50,6 +68,7 @@ public:
   size_t headerOffset() const;
   size_t pixelStep() const;
   size_t lineStep() const;
+  ptrdiff_t lineStride() const;
   size_t channelStep() const;
   size_t pixelAreaSize() const;
 
@@ -65,8 +84,23 @@ public:
   const void *pixelPtr(const void *inBufferPtr, unsigned int inX, unsigned int inY, unsigned int inPlaneIndex = 0) const;
   void *pixelPtr(void *inBufferPtr) const;
   const void *pixelPtr(const void *inBufferPtr) const;
+  bool getPixelValue(const void *inBufferPtr, unsigned int inX, unsigned int inY,
+                     PixelValue *outValue) const;
+
+  // Fast (unchecked) accessors for per-pixel code. Use the functions above
+  // when the coordinates are not known to be in range
+  unsigned int planeNum() const;
+  size_t planeOffsetFast(unsigned int inPlaneIndex = 0) const;
+  size_t lineOffsetFast(unsigned int inY, unsigned int inPlaneIndex = 0) const;
+  size_t pixelOffsetFast(unsigned int inX, unsigned int inY, unsigned int inPlaneIndex = 0) const;
+  unsigned char *linePtrFast(void *inBufferPtr, unsigned int inY, unsigned int inPlaneIndex = 0) const;
+  const unsigned char *linePtrFast(const void *inBufferPtr, unsigned int inY, unsigned int inPlaneIndex = 0) const;
+  unsigned char *pixelPtrFast(void *inBufferPtr, unsigned int inX, unsigned int inY, unsigned int inPlaneIndex = 0) const;
+  const unsigned char *pixelPtrFast(const void *inBufferPtr, unsigned int inX, unsigned int inY, unsigned int inPlaneIndex = 0) const;
 
   void invalidate();
+  bool operator==(const ImageFormat &inFormat) const;
+  bool operator!=(const ImageFormat &inFormat) const;
   void  set(const ImageType &inType,
               unsigned int inWidth, unsigned int inHeight,
               bool inIsBottomUp = false,
@@ -126,6 +160,86 @@ private:
   size_t          mLineStep;
   size_t          mChannelStep;
   size_t          mPixelAreaSize;
+  std::vector<size_t> mPlaneOffsetTable;
+
+  // Member functions ----------------------------------------------------------
+  void  updatePlaneOffsetTable();
+  bool  getPackedPixelValue(const void *inBufferPtr, unsigned int inX, unsigned int inY,
+                            PixelValue *outValue) const;
 };
 
+// Inline functions ------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// planeNum
+// -----------------------------------------------------------------------------
+inline unsigned int ImageFormat::planeNum() const
+{
+  return (unsigned int )mPlaneOffsetTable.size();
+}
+
+// -----------------------------------------------------------------------------
+// planeOffsetFast
+// -----------------------------------------------------------------------------
+inline size_t ImageFormat::planeOffsetFast(unsigned int inPlaneIndex) const
+{
+  assert(inPlaneIndex < mPlaneOffsetTable.size());
+  return mPlaneOffsetTable[inPlaneIndex];
+}
+
+// -----------------------------------------------------------------------------
+// lineOffsetFast
+// -----------------------------------------------------------------------------
+//  Line 0 of a bottom-up image is the last one in the buffer
+inline size_t ImageFormat::lineOffsetFast(unsigned int inY, unsigned int inPlaneIndex) const
+{
+  assert(inY < mHeight);
+  return planeOffsetFast(inPlaneIndex) + mLineStep * (mIsBottomUp ? mHeight - 1 - inY : inY);
+}
+
+// -----------------------------------------------------------------------------
+// pixelOffsetFast
+// -----------------------------------------------------------------------------
+inline size_t ImageFormat::pixelOffsetFast(unsigned int inX, unsigned int inY,
+                                           unsigned int inPlaneIndex) const
+{
+  assert(inX < mWidth);
+  return lineOffsetFast(inY, inPlaneIndex) + mPixelStep * inX;
+}
+
+// -----------------------------------------------------------------------------
+// linePtrFast
+// -----------------------------------------------------------------------------
+inline unsigned char *ImageFormat::linePtrFast(void *inBufferPtr, unsigned int inY,
+                                               unsigned int inPlaneIndex) const
+{
+  return (unsigned char *)inBufferPtr + lineOffsetFast(inY, inPlaneIndex);
+}
+
+// -----------------------------------------------------------------------------
+// linePtrFast
+// -----------------------------------------------------------------------------
+inline const unsigned char *ImageFormat::linePtrFast(const void *inBufferPtr, unsigned int inY,
+                                                     unsigned int inPlaneIndex) const
+{
+  return (const unsigned char *)inBufferPtr + lineOffsetFast(inY, inPlaneIndex);
+}
+
+// -----------------------------------------------------------------------------
+// pixelPtrFast
+// -----------------------------------------------------------------------------
+inline unsigned char *ImageFormat::pixelPtrFast(void *inBufferPtr, unsigned int inX,
+                                                unsigned int inY, unsigned int inPlaneIndex) const
+{
+  return (unsigned char *)inBufferPtr + pixelOffsetFast(inX, inY, inPlaneIndex);
+}
+
+// -----------------------------------------------------------------------------
+// pixelPtrFast
+// -----------------------------------------------------------------------------
+inline const unsigned char *ImageFormat::pixelPtrFast(const void *inBufferPtr, unsigned int inX,
+                                                      unsigned int inY, unsigned int inPlaneIndex) const
+{
+  return (const unsigned char *)inBufferPtr + pixelOffsetFast(inX, inY, inPlaneIndex);
+}
+
 #endif //QIV_IMAGE_FORMAT_H
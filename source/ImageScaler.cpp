@@ -0,0 +1,709 @@
+// =============================================================================
+//  ImageScaler.cpp
+//
+//  Written in 2022 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     ImageScaler.cpp
+  \author   Dairoku Sekiguchi
+  \version  1.0.0-pre_alpha.0
+  \date     2022/04/18
+*/
+
+// Includes --------------------------------------------------------------------
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <QtConcurrent>
+#include "ImageScaler.h"
+#include "PixelKernels.h"
+
+// -----------------------------------------------------------------------------
+// ImageScaler
+// -----------------------------------------------------------------------------
+ImageScaler::ImageScaler()
+{
+  mFilterType = FILTER_TYPE_AUTO;
+  mTransform = TRANSFORM_NONE;
+  mTargetFormat = QImage::Format_RGB32;
+  invalidate();
+}
+
+// -----------------------------------------------------------------------------
+// ~ImageScaler
+// -----------------------------------------------------------------------------
+ImageScaler::~ImageScaler()
+{
+}
+
+// Member functions ------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// render
+// -----------------------------------------------------------------------------
+//  ioImage is (re)allocated to the size of the target area (clipped to the
+//  zoomed image, in the view coordinates of the transform). inColorTable (256
+//  entries) replaces the color table of an 8-bit source (views with their own
+//  colormap share one source image)
+bool ImageScaler::render(const QImage &inSrc, double inZoomScale, const QRect &inTargetRect,
+                         QImage *ioImage, const uint32_t *inColorTable)
+{
+  if (inSrc.isNull() || inZoomScale <= 0.0)
+    return false;
+
+  // 8-bit images are resampled as indexes (averaged by the box filter) and
+  // then looked up in the color table
+  uint32_t  colorTable[256];
+  const uint32_t  *colorTablePtr = nullptr;
+  switch (inSrc.format())
+  {
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32:
+    case QImage::Format_ARGB32_Premultiplied:
+      break;
+    case QImage::Format_Indexed8:
+    {
+      QVector<QRgb> table = inSrc.colorTable();
+      for (int i = 0; i < 256; i++)
+        colorTable[i] = i < table.size() ? table[i] : 0xFF000000;
+      colorTablePtr = colorTable;
+      break;
+    }
+    case QImage::Format_Grayscale8:
+      for (uint32_t i = 0; i < 256; i++)
+        colorTable[i] = 0xFF000000 | (i << 16) | (i << 8) | i;
+      colorTablePtr = colorTable;
+      break;
+    default:
+      return false;
+  }
+  if (colorTablePtr != nullptr && inColorTable != nullptr)
+    colorTablePtr = inColorTable;
+
+  updateColumnTable(inSrc, inZoomScale);
+  QRect targetRect = inTargetRect.intersected(QRect(0, 0, mTargetWidth, mTargetHeight));
+  if (targetRect.isEmpty())
+    return false;
+  if (ioImage->size() != targetRect.size() || ioImage->format() != mTargetFormat)
+    *ioImage = QImage(targetRect.size(), mTargetFormat);
+
+  // The transposing transforms. Magnified, the source is transposed in
+  // blocks as it is resampled (renderTransposed()). Minified, the target
+  // has fewer pixels than the source : the source lines are resampled into
+  // target columns, a few at a time so that each target line gets their
+  // pixels side by side (renderTransposedMinified()). At 1:1 the source is
+  // transposed into the target (renderTransposedUnscaled())
+  bool  transposed = isTransposed(mTransform);
+
+  // Get the pointers here (QImage::scanLine() is not for concurrent use)
+  unsigned char *bits = ioImage->bits();
+  int   bytesPerLine = ioImage->bytesPerLine();
+  SourceBlock   src = {inSrc.constBits(), inSrc.bytesPerLine(), 0, 0};
+  auto  renderBand = [&](int inY0, int inY1)
+  {
+    if (transposed && mZoomScale < 1.0)
+      renderTransposedMinified(src, colorTablePtr, targetRect, inY0, inY1, bits, bytesPerLine);
+    else if (transposed && mZoomScale == 1.0)
+      renderTransposedUnscaled(src, colorTablePtr, targetRect, inY0, inY1, bits, bytesPerLine);
+    else if (transposed)
+      renderTransposed(src, colorTablePtr, targetRect, inY0, inY1, bits, bytesPerLine);
+    else
+      renderRows(src, colorTablePtr, targetRect, inY0, inY1, bits, bytesPerLine);
+  };
+
+  int height = targetRect.height();
+  int bandNum = QThreadPool::globalInstance()->maxThreadCount();
+  if ((qint64 )targetRect.width() * height < PARALLEL_PIXEL_NUM_MIN || bandNum <= 1)
+  {
+    renderBand(0, height);
+    return true;
+  }
+  if (bandNum > height / BAND_HEIGHT_MIN)
+    bandNum = height / BAND_HEIGHT_MIN;
+  if (bandNum < 1)
+    bandNum = 1;
+  std::vector<std::pair<int, int>>  bands(bandNum);
+  for (int i = 0; i < bandNum; i++)
+    bands[i] = std::make_pair((int )((qint64 )height * i / bandNum),
+                              (int )((qint64 )height * (i + 1) / bandNum));
+  QtConcurrent::blockingMap(bands, [&](const std::pair<int, int> &inBand)
+  {
+    renderBand(inBand.first, inBand.second);
+  });
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// invalidate
+// -----------------------------------------------------------------------------
+void ImageScaler::invalidate()
+{
+  mZoomScale = 0;
+  mSrcWidth = 0;
+  mSrcHeight = 0;
+  mTargetWidth = 0;
+  mTargetHeight = 0;
+  mColumnStart.clear();
+  mColumnEnd.clear();
+  mColumnScale.clear();
+}
+
+// -----------------------------------------------------------------------------
+// setFilterType
+// -----------------------------------------------------------------------------
+void ImageScaler::setFilterType(FilterType inType)
+{
+  mFilterType = inType;
+}
+
+// -----------------------------------------------------------------------------
+// getFilterType
+// -----------------------------------------------------------------------------
+ImageScaler::FilterType ImageScaler::getFilterType() const
+{
+  return mFilterType;
+}
+
+// -----------------------------------------------------------------------------
+// setTransform
+// -----------------------------------------------------------------------------
+void ImageScaler::setTransform(Transform inTransform)
+{
+  if (mTransform == inTransform)
+    return;
+  mTransform = inTransform;
+  invalidate();
+}
+
+// -----------------------------------------------------------------------------
+// getTransform
+// -----------------------------------------------------------------------------
+ImageScaler::Transform ImageScaler::getTransform() const
+{
+  return mTransform;
+}
+
+// -----------------------------------------------------------------------------
+// setTargetFormat
+// -----------------------------------------------------------------------------
+//  Format_ARGB32_Premultiplied keeps the alpha of the color table (an overlay
+//  with a premultiplied table). The pixels are the same, only the format of
+//  the rendered image differs from Format_RGB32
+void ImageScaler::setTargetFormat(QImage::Format inFormat)
+{
+  mTargetFormat = inFormat;
+}
+
+// -----------------------------------------------------------------------------
+// updateColumnTable
+// -----------------------------------------------------------------------------
+//  Target column x shows the source columns [floor(x / zoom), floor((x + 1) / zoom))
+//  (the same mapping as ImageView::mapToImage()), in reverse order for a
+//  horizontal flip. The columns of the transposing transforms are source
+//  rows. Only made when the zoom scale, the source size or the transform is
+//  changed
+void ImageScaler::updateColumnTable(const QImage &inSrc, double inZoomScale)
+{
+  QSize srcSize = transformSize(inSrc.size(), mTransform);
+  if (inZoomScale == mZoomScale && srcSize.width() == mSrcWidth && srcSize.height() == mSrcHeight)
+    return;
+
+  mZoomScale  = inZoomScale;
+  mSrcWidth   = srcSize.width();
+  mSrcHeight  = srcSize.height();
+  QSize targetSize = getTargetSize(srcSize, mZoomScale);
+  mTargetWidth  = targetSize.width();
+  mTargetHeight = targetSize.height();
+  bool  flipX = isFlippedHorizontally(mTransform);
+
+  mColumnStart.resize(mTargetWidth);
+  for (int x = 0; x < mTargetWidth; x++)
+  {
+    int start = (int )floor(x / mZoomScale);
+    mColumnStart[x] = start < mSrcWidth ? start : mSrcWidth - 1;
+  }
+  if (mZoomScale >= 1.0)
+  {
+    mColumnEnd.clear();
+    mColumnScale.clear();
+    if (flipX)
+      std::reverse(mColumnStart.begin(), mColumnStart.end());
+    return;
+  }
+  mColumnEnd.resize(mTargetWidth);
+  mColumnScale.resize(mTargetWidth);
+  for (int x = 0; x < mTargetWidth; x++)
+  {
+    int end = (int )floor((x + 1) / mZoomScale);
+    if (end > mSrcWidth)
+      end = mSrcWidth;
+    mColumnEnd[x] = end > mColumnStart[x] ? end : mColumnStart[x] + 1;
+    mColumnScale[x] = 1.0f / (float )(mColumnEnd[x] - mColumnStart[x]);
+  }
+  if (flipX)
+  {
+    std::reverse(mColumnStart.begin(), mColumnStart.end());
+    std::reverse(mColumnEnd.begin(), mColumnEnd.end());
+    std::reverse(mColumnScale.begin(), mColumnScale.end());
+  }
+}
+
+// -----------------------------------------------------------------------------
+// getSourceRows
+// -----------------------------------------------------------------------------
+//  inY is a target (view) row
+void ImageScaler::getSourceRows(int inY, int *outStart, int *outEnd) const
+{
+  if (isFlippedVertically(mTransform))
+    inY = mTargetHeight - 1 - inY;
+  int start = (int )floor(inY / mZoomScale);
+  int end   = (int )floor((inY + 1) / mZoomScale);
+  if (start >= mSrcHeight)
+    start = mSrcHeight - 1;
+  if (end > mSrcHeight)
+    end = mSrcHeight;
+  if (end <= start)
+    end = start + 1;
+  *outStart = start;
+  *outEnd   = end;
+}
+
+// -----------------------------------------------------------------------------
+// renderRows
+// -----------------------------------------------------------------------------
+void ImageScaler::renderRows(const SourceBlock &inSrc, const uint32_t *inColorTable,
+                             const QRect &inTargetRect,
+                             int inY0, int inY1, unsigned char *outBits, int inBytesPerLine) const
+{
+  if (mZoomScale >= 1.0 || mFilterType == FILTER_TYPE_NEAREST)
+    renderNearest(inSrc, inColorTable, inTargetRect, inY0, inY1, outBits, inBytesPerLine);
+  else
+    renderBox(inSrc, inColorTable, inTargetRect, inY0, inY1, outBits, inBytesPerLine);
+}
+
+// -----------------------------------------------------------------------------
+// renderTransposed
+// -----------------------------------------------------------------------------
+//  Magnified views of the transposing transforms (see render()). The target
+//  is done in tiles that need up to TRANSPOSE_BLOCK_LINES source lines and
+//  TRANSPOSE_BLOCK_BYTES of each. The source pixels of a tile are transposed
+//  into a small block, which is resampled as the normal path does
+void ImageScaler::renderTransposed(const SourceBlock &inSrc, const uint32_t *inColorTable,
+                                   const QRect &inTargetRect,
+                                   int inY0, int inY1, unsigned char *outBits, int inBytesPerLine) const
+{
+  size_t  pixelSize = inColorTable != nullptr ? 1 : 4;
+
+  // The source lines [outStart, outEnd) of the target columns [inA, inB)
+  auto  getLineRange = [&](int inA, int inB, int *outStart, int *outEnd)
+  {
+    int left  = inTargetRect.left() + inA;
+    int right = inTargetRect.left() + inB - 1;
+    *outStart = std::min(mColumnStart[left], mColumnStart[right]);   // Reversed when flipped
+    *outEnd   = mColumnEnd.empty() ? std::max(mColumnStart[left], mColumnStart[right]) + 1 :
+                                     std::max(mColumnEnd[left], mColumnEnd[right]);
+  };
+  // The source columns [outStart, outEnd) of the target rows [inA, inB)
+  auto  getColumnRange = [&](int inA, int inB, int *outStart, int *outEnd)
+  {
+    int start0, end0, start1, end1;
+    getSourceRows(inTargetRect.top() + inA, &start0, &end0);
+    getSourceRows(inTargetRect.top() + inB - 1, &start1, &end1);
+    *outStart = std::min(start0, start1);
+    *outEnd   = std::max(end0, end1);
+  };
+  // Splits [inBegin, inEnd) into the runs that need up to inLimit source
+  // pixels (at least one target pixel each)
+  auto  split = [](int inBegin, int inEnd, int inLimit, const auto &inGetRange,
+                   std::vector<int> *outBounds)
+  {
+    outBounds->clear();
+    for (int a = inBegin; a < inEnd; )
+    {
+      outBounds->push_back(a);
+      int b = a + 1;
+      for (; b < inEnd; b++)
+      {
+        int start, end;
+        inGetRange(a, b + 1, &start, &end);
+        if (end - start > inLimit)
+          break;
+      }
+      a = b;
+    }
+    outBounds->push_back(inEnd);
+  };
+
+  std::vector<int>  columnBounds, rowBounds;
+  split(0, inTargetRect.width(), TRANSPOSE_BLOCK_LINES, getLineRange, &columnBounds);
+  split(inY0, inY1, (int )(TRANSPOSE_BLOCK_BYTES / pixelSize), getColumnRange, &rowBounds);
+
+  std::vector<unsigned char>  block;
+  for (size_t j = 0; j + 1 < columnBounds.size(); j++)
+  {
+    QRect tileRect(inTargetRect.left() + columnBounds[j], inTargetRect.top(),
+                   columnBounds[j + 1] - columnBounds[j], inTargetRect.height());
+    unsigned char *tileBits = outBits + columnBounds[j] * sizeof(uint32_t);
+    int srcY0, srcY1;
+    getLineRange(columnBounds[j], columnBounds[j + 1], &srcY0, &srcY1);
+    for (size_t i = 0; i + 1 < rowBounds.size(); i++)
+    {
+      // Block line n is source column srcX0 + n (from source line srcY0)
+      int srcX0, srcX1;
+      getColumnRange(rowBounds[i], rowBounds[i + 1], &srcX0, &srcX1);
+      int blockBytesPerLine = (int )((srcY1 - srcY0) * pixelSize);
+      block.resize((size_t )blockBytesPerLine * (srcX1 - srcX0));
+      const unsigned char *src = inSrc.bits + (size_t )inSrc.bytesPerLine * srcY0 + srcX0 * pixelSize;
+      if (pixelSize == 1)
+        PixelKernels::transpose8(src, inSrc.bytesPerLine, block.data(), blockBytesPerLine,
+                                 srcX1 - srcX0, srcY1 - srcY0);
+      else
+        PixelKernels::transpose32((const uint32_t *)src, inSrc.bytesPerLine,
+                                  (uint32_t *)block.data(), blockBytesPerLine,
+                                  srcX1 - srcX0, srcY1 - srcY0);
+      SourceBlock blockSrc = {block.data(), blockBytesPerLine, srcY0, srcX0};
+      renderNearest(blockSrc, inColorTable, tileRect, rowBounds[i], rowBounds[i + 1],
+                    tileBits, inBytesPerLine);
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+// renderTransposedUnscaled
+// -----------------------------------------------------------------------------
+//  Target column x shows the source line mColumnStart[x] and target row y the
+//  source column of getSourceRows(y), both consecutive (the flips are the
+//  negative strides). 8-bit sources are transposed into a block, which is
+//  looked up into the target
+void ImageScaler::renderTransposedUnscaled(const SourceBlock &inSrc, const uint32_t *inColorTable,
+                                           const QRect &inTargetRect, int inY0, int inY1,
+                                           unsigned char *outBits, int inBytesPerLine) const
+{
+  int       width = inTargetRect.width();
+  size_t    pixelSize = inColorTable != nullptr ? 1 : 4;
+  ptrdiff_t srcStride = isFlippedHorizontally(mTransform) ? -inSrc.bytesPerLine : inSrc.bytesPerLine;
+  bool      flipY = isFlippedVertically(mTransform);
+  const unsigned char *srcLine = inSrc.bits + (size_t )inSrc.bytesPerLine * mColumnStart[inTargetRect.left()];
+  int       blockHeight = TRANSPOSE_BLOCK_BYTES / (int )pixelSize;
+  std::vector<unsigned char>  block;
+  if (pixelSize == 1)
+    block.resize((size_t )width * blockHeight);
+
+  for (int y = inY0; y < inY1; y += blockHeight)
+  {
+    // The source columns [srcX, srcX + n) are the rows [y, y + n) (reversed when flipped)
+    int n = std::min(blockHeight, inY1 - y);
+    int srcX, srcXEnd;
+    getSourceRows(inTargetRect.top() + (flipY ? y + n - 1 : y), &srcX, &srcXEnd);
+    int dstY = flipY ? y + n - 1 : y;
+    ptrdiff_t dstStride = flipY ? -inBytesPerLine : inBytesPerLine;
+    const unsigned char *src = srcLine + srcX * pixelSize;
+    if (pixelSize == 4)
+    {
+      PixelKernels::transpose32((const uint32_t *)src, srcStride,
+                                (uint32_t *)(outBits + (size_t )inBytesPerLine * dstY), dstStride,
+                                n, width);
+      continue;
+    }
+    PixelKernels::transpose8(src, srcStride, block.data(), width, n, width);
+    for (int i = 0; i < n; i++)
+      PixelKernels::applyLUT8(block.data() + (size_t )width * i, inColorTable,
+                              (uint32_t *)(outBits + (size_t )inBytesPerLine * dstY + dstStride * i),
+                              width);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// renderTransposedMinified
+// -----------------------------------------------------------------------------
+//  Target column x is resampled from the source lines [mColumnStart[x],
+//  mColumnEnd[x]) as renderBox() does a target row. A few columns are done at
+//  once, so that each target line gets their pixels side by side instead of
+//  one at a time. Indexed sources give the indexes (averaged by the box
+//  filter), the color table is applied to whole target lines at the end
+void ImageScaler::renderTransposedMinified(const SourceBlock &inSrc, const uint32_t *inColorTable,
+                                           const QRect &inTargetRect, int inY0, int inY1,
+                                           unsigned char *outBits, int inBytesPerLine) const
+{
+  int     width = inTargetRect.width();
+  int     height = inY1 - inY0;
+  std::vector<int32_t>  rowStart(height), rowEnd(height);
+  std::vector<float>    rowScale(height);
+  for (int i = 0; i < height; i++)
+  {
+    int start, end;
+    getSourceRows(inTargetRect.top() + inY0 + i, &start, &end);
+    rowStart[i] = start;
+    rowEnd[i]   = end;
+    rowScale[i] = 1.0f / (float )(end - start);
+  }
+  int     srcX0 = std::min(rowStart[0], rowStart[height - 1]);   // Reversed when flipped
+  int     srcX1 = std::max(rowEnd[0], rowEnd[height - 1]);
+  for (int i = 0; i < height; i++)
+  {
+    rowStart[i] -= srcX0;
+    rowEnd[i]   -= srcX0;
+  }
+  size_t  componentNum = inColorTable != nullptr ? 1 : 4;
+  const unsigned char *src = inSrc.bits + srcX0 * componentNum;
+  unsigned char *dst = outBits + (size_t )inBytesPerLine * inY0;
+  std::vector<uint8_t>  indexes(inColorTable != nullptr ? (size_t )width * height : 0);
+
+  if (mFilterType == FILTER_TYPE_NEAREST)
+  {
+    // The first source line of each column
+    int columnNum = TRANSPOSE_BLOCK_BYTES / (int )sizeof(uint32_t);
+    std::vector<const unsigned char *>  lines(columnNum);
+    for (int x0 = 0; x0 < width; x0 += columnNum)
+    {
+      int n = std::min(columnNum, width - x0);
+      for (int i = 0; i < n; i++)
+        lines[i] = src + (size_t )inSrc.bytesPerLine * mColumnStart[inTargetRect.left() + x0 + i];
+      if (inColorTable != nullptr)
+        PixelKernels::gatherColumns8(lines.data(), n, rowStart.data(),
+                                     indexes.data() + x0, width, height);
+      else
+        PixelKernels::gatherColumns32((const uint32_t *const *)lines.data(), n, rowStart.data(),
+                                      (uint32_t *)(dst + x0 * sizeof(uint32_t)), inBytesPerLine,
+                                      height);
+    }
+  }
+  else
+  {
+    // The sums of the source lines of each column
+    int     columnNum = (int )(inColorTable != nullptr ? PixelKernels::BOX_REDUCE_COLUMN_NUM_8 :
+                                                         PixelKernels::BOX_REDUCE_COLUMN_NUM_32);
+    size_t  sumSize = (size_t )(srcX1 - srcX0) * componentNum;
+    std::vector<uint32_t> sum(sumSize * columnNum);
+    for (int x0 = 0; x0 < width; x0 += columnNum)
+    {
+      int n = std::min(columnNum, width - x0);
+      for (int i = 0; i < n; i++)
+      {
+        int x = inTargetRect.left() + x0 + i;
+        uint32_t  *columnSum = sum.data() + sumSize * i;
+        std::fill(columnSum, columnSum + sumSize, 0);
+        for (int srcY = mColumnStart[x]; srcY < mColumnEnd[x]; srcY++)
+          PixelKernels::accumulate8(src + (size_t )inSrc.bytesPerLine * srcY, columnSum, sumSize);
+      }
+      const float *columnScale = mColumnScale.data() + inTargetRect.left() + x0;
+      if (inColorTable != nullptr)
+        PixelKernels::boxReduceColumns8(sum.data(), sumSize, n, rowStart.data(), rowEnd.data(),
+                                        rowScale.data(), columnScale,
+                                        indexes.data() + x0, width, height);
+      else
+        PixelKernels::boxReduceColumns32(sum.data(), sumSize, n, rowStart.data(), rowEnd.data(),
+                                         rowScale.data(), columnScale,
+                                         dst + x0 * sizeof(uint32_t), inBytesPerLine, height);
+    }
+  }
+
+  if (inColorTable != nullptr)
+    for (int y = 0; y < height; y++)
+      PixelKernels::applyLUT8(indexes.data() + (size_t )width * y, inColorTable,
+                              (uint32_t *)(dst + (size_t )inBytesPerLine * y), width);
+}
+
+// -----------------------------------------------------------------------------
+// renderNearest
+// -----------------------------------------------------------------------------
+//  Rows that show the same source row (always the case at high zoom) are
+//  copied from the previous one. inColorTable is nullptr for 32-bit sources
+void ImageScaler::renderNearest(const SourceBlock &inSrc, const uint32_t *inColorTable,
+                                const QRect &inTargetRect,
+                                int inY0, int inY1, unsigned char *outBits, int inBytesPerLine) const
+{
+  int     width = inTargetRect.width();
+  const int32_t *columnIndex = mColumnStart.data() + inTargetRect.left();
+  std::vector<int32_t>  relIndex;
+  if (inSrc.x0 != 0)
+  {
+    relIndex.resize(width);
+    for (int x = 0; x < width; x++)
+      relIndex[x] = columnIndex[x] - inSrc.x0;
+    columnIndex = relIndex.data();
+  }
+  int     prevSrcY = -1;
+  const uint32_t  *prevDst = nullptr;
+
+  for (int y = inY0; y < inY1; y++)
+  {
+    int srcY, srcYEnd;
+    getSourceRows(inTargetRect.top() + y, &srcY, &srcYEnd);
+    uint32_t  *dst = (uint32_t *)(outBits + (size_t )inBytesPerLine * y);
+    const unsigned char *src = inSrc.bits + (size_t )inSrc.bytesPerLine * (srcY - inSrc.y0);
+    if (srcY == prevSrcY)
+      memcpy(dst, prevDst, sizeof(uint32_t) * width);
+    else if (inColorTable != nullptr)
+      PixelKernels::gatherLUT8(src, columnIndex, inColorTable, dst, width);
+    else
+      PixelKernels::gather32((const uint32_t *)src, columnIndex, dst, width);
+    prevSrcY = srcY;
+    prevDst = dst;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// renderBox
+// -----------------------------------------------------------------------------
+//  Separable box filter : the source rows of a target row are summed per
+//  component first, then the columns of each target pixel
+void ImageScaler::renderBox(const SourceBlock &inSrc, const uint32_t *inColorTable,
+                            const QRect &inTargetRect,
+                            int inY0, int inY1, unsigned char *outBits, int inBytesPerLine) const
+{
+  int     width = inTargetRect.width();
+  const int32_t *columnStart = mColumnStart.data() + inTargetRect.left();
+  const int32_t *columnEnd   = mColumnEnd.data() + inTargetRect.left();
+  const float   *columnScale = mColumnScale.data() + inTargetRect.left();
+  int     srcX0 = std::min(columnStart[0], columnStart[width - 1]);   // Reversed when flipped
+  int     srcX1 = std::max(columnEnd[0], columnEnd[width - 1]);
+  size_t  componentNum = inColorTable != nullptr ? 1 : 4;
+  std::vector<uint32_t> sum((size_t )(srcX1 - srcX0) * componentNum);
+  std::vector<int32_t>  relStart(width), relEnd(width);
+  for (int x = 0; x < width; x++)
+  {
+    relStart[x] = columnStart[x] - srcX0;
+    relEnd[x]   = columnEnd[x] - srcX0;
+  }
+
+  for (int y = inY0; y < inY1; y++)
+  {
+    int srcY0, srcY1;
+    getSourceRows(inTargetRect.top() + y, &srcY0, &srcY1);
+    std::fill(sum.begin(), sum.end(), 0);
+    float rowScale = 1.0f / (float )(srcY1 - srcY0);
+    for (int srcY = srcY0; srcY < srcY1; srcY++)
+      PixelKernels::accumulate8(inSrc.bits + (size_t )inSrc.bytesPerLine * (srcY - inSrc.y0) +
+                                (srcX0 - inSrc.x0) * componentNum, sum.data(), sum.size());
+
+    // Column tables are relative to srcX0 (the first column in sum)
+    unsigned char *dst = outBits + (size_t )inBytesPerLine * y;
+    if (inColorTable != nullptr)
+      PixelKernels::boxReduceLUT8(sum.data(), relStart.data(), relEnd.data(), columnScale, rowScale,
+                                  inColorTable, (uint32_t *)dst, width);
+    else
+      PixelKernels::boxReduce32(sum.data(), relStart.data(), relEnd.data(), columnScale, rowScale,
+                                dst, width);
+  }
+}
+
+// Static Functions ------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// getTargetSize
+// -----------------------------------------------------------------------------
+//  The size of the zoomed image (before the transform)
+QSize ImageScaler::getTargetSize(const QSize &inSrcSize, double inZoomScale)
+{
+  return QSize((int )ceil(inSrcSize.width() * inZoomScale),
+               (int )ceil(inSrcSize.height() * inZoomScale));
+}
+
+// -----------------------------------------------------------------------------
+// transformSize
+// -----------------------------------------------------------------------------
+//  The size in the view (width and height swapped by the transposing ones)
+QSize ImageScaler::transformSize(const QSize &inSize, Transform inTransform)
+{
+  if (isTransposed(inTransform))
+    return QSize(inSize.height(), inSize.width());
+  return inSize;
+}
+
+// -----------------------------------------------------------------------------
+// transformRect
+// -----------------------------------------------------------------------------
+//  Zoomed image coordinates (inTargetSize) -> view coordinates. Every
+//  transform is an optional transposition followed by the flips (in the view)
+QRect ImageScaler::transformRect(const QRect &inRect, const QSize &inTargetSize,
+                                 Transform inTransform)
+{
+  if (inRect.isEmpty())
+    return inRect;
+  QRect rect = inRect;
+  if (isTransposed(inTransform))
+    rect = QRect(inRect.y(), inRect.x(), inRect.height(), inRect.width());
+  QSize size = transformSize(inTargetSize, inTransform);
+  int x = rect.x();
+  int y = rect.y();
+  if (isFlippedHorizontally(inTransform))
+    x = size.width() - 1 - rect.right();
+  if (isFlippedVertically(inTransform))
+    y = size.height() - 1 - rect.bottom();
+  return QRect(x, y, rect.width(), rect.height());
+}
+
+// -----------------------------------------------------------------------------
+// inverseTransformRect
+// -----------------------------------------------------------------------------
+//  View coordinates -> zoomed image coordinates (the flips first, then the
+//  transposition)
+QRect ImageScaler::inverseTransformRect(const QRect &inRect, const QSize &inTargetSize,
+                                        Transform inTransform)
+{
+  if (inRect.isEmpty())
+    return inRect;
+  QSize size = transformSize(inTargetSize, inTransform);
+  int x = inRect.x();
+  int y = inRect.y();
+  if (isFlippedHorizontally(inTransform))
+    x = size.width() - 1 - inRect.right();
+  if (isFlippedVertically(inTransform))
+    y = size.height() - 1 - inRect.bottom();
+  if (isTransposed(inTransform))
+    return QRect(y, x, inRect.height(), inRect.width());
+  return QRect(x, y, inRect.width(), inRect.height());
+}
+
+// -----------------------------------------------------------------------------
+// getPainterTransform
+// -----------------------------------------------------------------------------
+//  For the parts drawn by QPainter (zoomed image coordinates -> view)
+QTransform ImageScaler::getPainterTransform(const QSize &inTargetSize, Transform inTransform)
+{
+  QSize size = transformSize(inTargetSize, inTransform);
+  bool  flipX = isFlippedHorizontally(inTransform);
+  bool  flipY = isFlippedVertically(inTransform);
+  double  scaleX = flipX ? -1.0 : 1.0;
+  double  scaleY = flipY ? -1.0 : 1.0;
+  double  dx = flipX ? size.width() : 0.0;
+  double  dy = flipY ? size.height() : 0.0;
+  if (isTransposed(inTransform))
+    return QTransform(0.0, scaleY, scaleX, 0.0, dx, dy);
+  return QTransform(scaleX, 0.0, 0.0, scaleY, dx, dy);
+}
+
+// -----------------------------------------------------------------------------
+// isFlippedHorizontally
+// -----------------------------------------------------------------------------
+//  In the view, after the transposition (if any)
+bool ImageScaler::isFlippedHorizontally(Transform inTransform)
+{
+  return inTransform == TRANSFORM_FLIP_HORIZONTAL || inTransform == TRANSFORM_ROTATE_180 ||
+         inTransform == TRANSFORM_ROTATE_90 || inTransform == TRANSFORM_TRANSVERSE;
+}
+
+// -----------------------------------------------------------------------------
+// isFlippedVertically
+// -----------------------------------------------------------------------------
+bool ImageScaler::isFlippedVertically(Transform inTransform)
+{
+  return inTransform == TRANSFORM_FLIP_VERTICAL || inTransform == TRANSFORM_ROTATE_180 ||
+         inTransform == TRANSFORM_ROTATE_270 || inTransform == TRANSFORM_TRANSVERSE;
+}
+
+// -----------------------------------------------------------------------------
+// isTransposed
+// -----------------------------------------------------------------------------
+bool ImageScaler::isTransposed(Transform inTransform)
+{
+  return inTransform == TRANSFORM_ROTATE_90 || inTransform == TRANSFORM_ROTATE_270 ||
+         inTransform == TRANSFORM_TRANSPOSE || inTransform == TRANSFORM_TRANSVERSE;
+}
@@ -0,0 +1,137 @@
+// =============================================================================
+//  ImageScaler.h
+//
+//  Written in 2022 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     ImageScaler.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0-pre_alpha.0
+  \date     2022/04/18
+*/
+#ifndef QIV_IMAGE_SCALER_H
+#define QIV_IMAGE_SCALER_H
+
+// Includes --------------------------------------------------------------------
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <QImage>
+#include <QTransform>
+
+// -----------------------------------------------------------------------------
+// ImageScaler class
+// -----------------------------------------------------------------------------
+//  Resamples the display image (Format_RGB32 / ARGB32, or Indexed8 /
+//  Grayscale8 which are looked up after resampling) at a zoom scale into a
+//  Format_RGB32 image of just the target area (in zoomed coordinates), so
+//  that it can be drawn 1:1.
+//  Nearest neighbor on the exact pixel grid of mapToImage() for magnification
+//  and a box filter for minification. The per-column source positions are
+//  made once per zoom scale and the rows are processed in parallel.
+//  The flips are view transforms : the column tables and the row mapping
+//  are mirrored, so a flipped view costs the same as the normal one. The
+//  transposing ones (90 / 270 degree rotation) transpose whichever side has
+//  fewer pixels in cache sized blocks : the source when magnified (see
+//  renderTransposed()), the resampled target when minified (see render())
+class ImageScaler
+{
+public:
+  // Constants -----------------------------------------------------------------
+  enum FilterType
+  {
+    FILTER_TYPE_AUTO  = 0,    // Nearest (magnification) or box (minification)
+    FILTER_TYPE_NEAREST       // Always nearest (fast, for the interim frames)
+  };
+  enum Transform
+  {
+    TRANSFORM_NONE    = 0,
+    TRANSFORM_FLIP_HORIZONTAL,    // Mirrored left to right
+    TRANSFORM_FLIP_VERTICAL,      // Upside down
+    TRANSFORM_ROTATE_180,
+    TRANSFORM_ROTATE_90,          // Clockwise
+    TRANSFORM_ROTATE_270,
+    TRANSFORM_TRANSPOSE,          // Mirrored on the main diagonal
+    TRANSFORM_TRANSVERSE          // Mirrored on the anti-diagonal
+  };
+
+  const static int  PARALLEL_PIXEL_NUM_MIN = 65536;  // Smaller areas are done in the caller's thread
+  const static int  BAND_HEIGHT_MIN        = 16;
+  const static int  TRANSPOSE_BLOCK_BYTES  = 128;    // Of each line per transposed block
+  const static int  TRANSPOSE_BLOCK_LINES  = 4096;   // Lines per transposed block (magnified)
+
+  // Constructors and Destructor -----------------------------------------------
+  ImageScaler();
+  virtual ~ImageScaler();
+
+  // Member functions ----------------------------------------------------------
+  bool render(const QImage &inSrc, double inZoomScale, const QRect &inTargetRect,
+              QImage *ioImage, const uint32_t *inColorTable = nullptr);
+  void invalidate();
+  void setFilterType(FilterType inType);
+  FilterType getFilterType() const;
+  void setTransform(Transform inTransform);
+  Transform getTransform() const;
+  void setTargetFormat(QImage::Format inFormat);
+
+  // Static Functions ----------------------------------------------------------
+  static QSize getTargetSize(const QSize &inSrcSize, double inZoomScale);
+  static QSize transformSize(const QSize &inSize, Transform inTransform);
+  static QRect transformRect(const QRect &inRect, const QSize &inTargetSize, Transform inTransform);
+  static QRect inverseTransformRect(const QRect &inRect, const QSize &inTargetSize,
+                                    Transform inTransform);
+  static QTransform getPainterTransform(const QSize &inTargetSize, Transform inTransform);
+  static bool isFlippedHorizontally(Transform inTransform);
+  static bool isFlippedVertically(Transform inTransform);
+  static bool isTransposed(Transform inTransform);
+
+private:
+  // The source of the resampling : pixel (x, y) is at bits + bytesPerLine *
+  // (y - y0) + (x - x0) * pixel size (a transposed block or the display image)
+  struct SourceBlock
+  {
+    const unsigned char *bits;
+    int   bytesPerLine;
+    int   x0, y0;
+  };
+
+  // Member variables ----------------------------------------------------------
+  FilterType  mFilterType;
+  Transform   mTransform;
+  QImage::Format  mTargetFormat;   // Format_RGB32 or Format_ARGB32_Premultiplied
+  double  mZoomScale;
+  int     mSrcWidth;      // Of the transposed source for the transposing transforms
+  int     mSrcHeight;
+  int     mTargetWidth;
+  int     mTargetHeight;
+  std::vector<int32_t>  mColumnStart;   // First source column of each target (view) column
+  std::vector<int32_t>  mColumnEnd;     // Minification only (exclusive)
+  std::vector<float>    mColumnScale;   // Minification only (1 / column count)
+
+  // Member functions ----------------------------------------------------------
+  void  updateColumnTable(const QImage &inSrc, double inZoomScale);
+  void  getSourceRows(int inY, int *outStart, int *outEnd) const;
+  void  renderRows(const SourceBlock &inSrc, const uint32_t *inColorTable, const QRect &inTargetRect,
+                   int inY0, int inY1, unsigned char *outBits, int inBytesPerLine) const;
+  void  renderTransposed(const SourceBlock &inSrc, const uint32_t *inColorTable, const QRect &inTargetRect,
+                         int inY0, int inY1, unsigned char *outBits, int inBytesPerLine) const;
+  void  renderTransposedMinified(const SourceBlock &inSrc, const uint32_t *inColorTable,
+                                 const QRect &inTargetRect,
+                                 int inY0, int inY1, unsigned char *outBits, int inBytesPerLine) const;
+  void  renderTransposedUnscaled(const SourceBlock &inSrc, const uint32_t *inColorTable,
+                                 const QRect &inTargetRect,
+                                 int inY0, int inY1, unsigned char *outBits, int inBytesPerLine) const;
+  void  renderNearest(const SourceBlock &inSrc, const uint32_t *inColorTable, const QRect &inTargetRect,
+                      int inY0, int inY1, unsigned char *outBits, int inBytesPerLine) const;
+  void  renderBox(const SourceBlock &inSrc, const uint32_t *inColorTable, const QRect &inTargetRect,
+                  int inY0, int inY1, unsigned char *outBits, int inBytesPerLine) const;
+};
+
+#endif //QIV_IMAGE_SCALER_H
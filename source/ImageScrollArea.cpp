@@ -25,11 +25,30 @@
 // -----------------------------------------------------------------------------
 ImageScrollArea::ImageScrollArea(QWidget *parent)
   : QScrollArea(parent),
-    mImageView(this)
+    mImageView(this),
+    mWheelTimer(this),
+    mZoomSettleTimer(this),
+    mWheelDelta(0),
+    mPixelInfoEmpty(true),
+    mPixelInfoData(nullptr),
+    mPixelInfoX(0),
+    mPixelInfoY(0),
+    mPixelInfoFrameGeneration(0),
+    mPixelInfoDisplayGeneration(0)
 {
   setBackgroundRole(QPalette::Dark);
   setAlignment(Qt::AlignHCenter | Qt::AlignVCenter);
   setWidget(&mImageView);
+
+  // Mouse tracking is required for the pixel value readout
+  setMouseTracking(true);
+  viewport()->setMouseTracking(true);
+  mImageView.setMouseTracking(true);
+
+  mWheelTimer.setSingleShot(true);
+  mZoomSettleTimer.setSingleShot(true);
+  connect(&mWheelTimer, &QTimer::timeout, this, &ImageScrollArea::applyWheelZoom);
+  connect(&mZoomSettleTimer, &QTimer::timeout, this, &ImageScrollArea::zoomSettled);
 }
 
 // -----------------------------------------------------------------------------
@@ -45,7 +64,7 @@ ImageView *ImageScrollArea::getImageView()
 // -----------------------------------------------------------------------------
 void ImageScrollArea::mousePressEvent(QMouseEvent *event)
 {
-  if (event->button() == Qt::LeftButton)
+  if (event->button() == Qt::LeftButton || event->button() == Qt::RightButton)
   {
     mMousePreviousPos = event->pos();
   }
@@ -56,10 +75,20 @@ void ImageScrollArea::mousePressEvent(QMouseEvent *event)
 // -----------------------------------------------------------------------------
 void ImageScrollArea::mouseMoveEvent(QMouseEvent *event)
 {
-  QPoint  diff = mMousePreviousPos - event->pos();
-  setScrollBarValueDiff(horizontalScrollBar(), diff.x());
-  setScrollBarValueDiff(verticalScrollBar(), diff.y());
-  mMousePreviousPos = event->pos();
+  if (event->buttons() & Qt::LeftButton)
+  {
+    QPoint  diff = mMousePreviousPos - event->pos();
+    setScrollBarValueDiff(horizontalScrollBar(), diff.x());
+    setScrollBarValueDiff(verticalScrollBar(), diff.y());
+    mMousePreviousPos = event->pos();
+  }
+  else if (event->buttons() & Qt::RightButton)
+  {
+    adjustWindowLevel(event->pos() - mMousePreviousPos);
+    mMousePreviousPos = event->pos();
+    return;
+  }
+  updatePixelInfo(event->pos());
 }
 
 // -----------------------------------------------------------------------------
@@ -72,30 +101,158 @@ void ImageScrollArea::mouseReleaseEvent([[maybe_unused]]QMouseEvent *event)
 // -----------------------------------------------------------------------------
 // wheelEvent
 // -----------------------------------------------------------------------------
+//  Only accumulates the delta. A touchpad sends dozens of small events per
+//  gesture, they are applied together once per frame (see applyWheelZoom())
 void ImageScrollArea::wheelEvent(QWheelEvent *wEvent)
 {
-  QPoint delta = wEvent->angleDelta();
-  QPoint pos = mImageView.mapFromGlobal(wEvent->globalPos());
+  mWheelDelta += wEvent->angleDelta().y();
+  mWheelGlobalPos = wEvent->globalPos();
+  if (mWheelTimer.isActive() == false)
+    mWheelTimer.start(WHEEL_COALESCE_TIME);
+  wEvent->accept();
+}
+
+// -----------------------------------------------------------------------------
+// applyWheelZoom
+// -----------------------------------------------------------------------------
+//  The view is rendered with the fast filter until the zoom settles. The
+//  remainder of the delta (less than a step) is kept for the next events
+void ImageScrollArea::applyWheelZoom()
+{
+  int step = mWheelDelta / MOUSE_WHEEL_ZOOM_STEP;
+  if (step == 0)
+    return;
+  mWheelDelta -= step * MOUSE_WHEEL_ZOOM_STEP;
+
+  QPoint pos = mImageView.mapFromGlobal(mWheelGlobalPos);
   QSize size = mImageView.size();
-  double hOffset = pos.x() * (1.0 / mImageView.getZoomScale()); // Offset from the origin
-  double vOffset = pos.y() * (1.0 / mImageView.getZoomScale());
+  QPointF imagePos = mImageView.mapToImagePos(pos);  // Kept under the cursor (any view transform)
   int x_offset = pos.x() - horizontalScrollBar()->value();  // Offset on the display
   int y_offset = pos.y() - verticalScrollBar()->value();
 
-  int step = delta.y() / MOUSE_WHEEL_ZOOM_STEP;
   double scale = mImageView.calcZoomScale(step);
+  mImageView.setInterimRendering(true);
   mImageView.setZoomScale(scale);
+  mZoomSettleTimer.start(ZOOM_SETTLE_TIME);
 
   if (pos.x() >= 0 && pos.x() < size.width() &&
     pos.y() >= 0 && pos.y() < size.height())
   {
-    int h = (int)(hOffset * mImageView.getZoomScale()) - x_offset;
-    int v = (int)(vOffset * mImageView.getZoomScale()) - y_offset;
+    QPointF newPos = mImageView.mapFromImagePos(imagePos);
+    int h = (int)newPos.x() - x_offset;
+    int v = (int)newPos.y() - y_offset;
     setScrollBarValue(horizontalScrollBar(), h);
     setScrollBarValue(verticalScrollBar(), v);
   }
 }
 
+// -----------------------------------------------------------------------------
+// zoomSettled
+// -----------------------------------------------------------------------------
+void ImageScrollArea::zoomSettled()
+{
+  mImageView.setInterimRendering(false);
+}
+
+// -----------------------------------------------------------------------------
+// leaveEvent
+// -----------------------------------------------------------------------------
+void ImageScrollArea::leaveEvent(QEvent *event)
+{
+  clearPixelInfo();
+  QScrollArea::leaveEvent(event);
+}
+
+// -----------------------------------------------------------------------------
+// updatePixelInfo
+// -----------------------------------------------------------------------------
+//  Nothing is done while the cursor stays on the same pixel of the same frame
+//  and display image (most mouse events), the text is made only when it changes
+void ImageScrollArea::updatePixelInfo(const QPoint &inPos)
+{
+  ImageData *imageData = mImageView.getImageData();
+  ImageData::FramePtr frame;
+  unsigned int  x, y;
+
+  if (imageData != nullptr)
+    frame = imageData->getFrame();
+  if (frame == nullptr ||
+      mImageView.mapToImage(mImageView.mapFrom(viewport(), inPos), &x, &y) == false)
+  {
+    clearPixelInfo();
+    return;
+  }
+  unsigned int  displayGeneration = imageData->getDisplayGeneration();
+  if (imageData == mPixelInfoData && x == mPixelInfoX && y == mPixelInfoY &&
+      frame->generation == mPixelInfoFrameGeneration &&
+      displayGeneration == mPixelInfoDisplayGeneration)
+    return;
+
+  PixelValue  value;
+  if (frame->format.getPixelValue(frame->buffer.get(), x, y, &value) == false)
+  {
+    clearPixelInfo();
+    return;
+  }
+  mPixelInfoEmpty = false;
+  mPixelInfoData = imageData;
+  mPixelInfoX = x;
+  mPixelInfoY = y;
+  mPixelInfoFrameGeneration = frame->generation;
+  mPixelInfoDisplayGeneration = displayGeneration;
+
+  QString info = QString("(%1, %2) :").arg(x).arg(y);
+  for (unsigned int i = 0; i < value.componentNum; i++)
+  {
+    if (value.isFloat)
+      info += QString(" %1").arg(value.floatValue[i], 0, 'g', 6);
+    else
+      info += QString(" %1").arg(value.intValue[i]);
+  }
+
+  QRgb  rgb;
+  if (imageData->getDisplayColor(x, y, &rgb))
+    info += QString("  RGB (%1, %2, %3)").arg(qRed(rgb)).arg(qGreen(rgb)).arg(qBlue(rgb));
+  emit pixelInfoChanged(info);
+}
+
+// -----------------------------------------------------------------------------
+// clearPixelInfo
+// -----------------------------------------------------------------------------
+void ImageScrollArea::clearPixelInfo()
+{
+  mPixelInfoData = nullptr;
+  if (mPixelInfoEmpty)
+    return;
+  mPixelInfoEmpty = true;
+  emit pixelInfoChanged(QString());
+}
+
+// -----------------------------------------------------------------------------
+// adjustWindowLevel
+// -----------------------------------------------------------------------------
+//  Horizontal drag changes the window width, vertical drag changes the level.
+//  Only the parameters are changed here. The display table is regenerated once
+//  at the next present (the requests are merged by the FramePresenter), so any
+//  number of mouse events between two frames costs one table and the visible
+//  tiles. The other tiles are converted after them
+void ImageScrollArea::adjustWindowLevel(const QPoint &inDiff)
+{
+  ImageData *imageData = mImageView.getImageData();
+  if (imageData == nullptr)
+    return;
+
+  double  window, level;
+  double  step = imageData->getWindowLevelRange() / WINDOW_LEVEL_DRAG_RANGE;
+  imageData->getWindowLevel(&window, &level);
+  imageData->setWindowLevel(window + inDiff.x() * step, level - inDiff.y() * step);
+  imageData->getWindowLevel(&window, &level);
+  imageData->redrawAllWidgets();
+  mPixelInfoEmpty = false;
+  mPixelInfoData = nullptr;   // The readout is made again at the next move
+  emit pixelInfoChanged(QString("Window %1  Level %2").arg(window, 0, 'f', 1).arg(level, 0, 'f', 1));
+}
+
 // -----------------------------------------------------------------------------
 // setScrollBarValue
 // -----------------------------------------------------------------------------
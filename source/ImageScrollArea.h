@@ -35,6 +35,9 @@ public:
   // Constants -----------------------------------------------------------------
   //const static int    ZOOM_STEP_DEFAULT     = 1;
   const static int    MOUSE_WHEEL_ZOOM_STEP = 60;
+  const static int    WHEEL_COALESCE_TIME   = 16;    // ms (wheel events are applied once per frame)
+  const static int    ZOOM_SETTLE_TIME      = 200;   // ms (then rendered at full quality)
+  const static int    WINDOW_LEVEL_DRAG_RANGE = 512;   // Drag distance for the full range
 
   // Constructors and Destructor -----------------------------------------------
   ImageScrollArea(QWidget *parent = Q_NULLPTR);
@@ -42,19 +45,39 @@ public:
   // Member functions ----------------------------------------------------------
   ImageView *getImageView();
 
+signals:
+  void pixelInfoChanged(const QString &inInfo);
+
 protected:
   // Member variables ----------------------------------------------------------
   ImageView mImageView;
   QPoint  mMousePreviousPos;
+  QTimer  mWheelTimer;
+  QTimer  mZoomSettleTimer;
+  int     mWheelDelta;          // Accumulated angle delta (not applied yet)
+  QPoint  mWheelGlobalPos;      // Zoom center of the latest wheel event
+  bool    mPixelInfoEmpty;      // Nothing shown by pixelInfoChanged()
+  const ImageData *mPixelInfoData;  // The readout shown (nullptr : none, see updatePixelInfo())
+  unsigned int  mPixelInfoX, mPixelInfoY;
+  uint64_t      mPixelInfoFrameGeneration;
+  unsigned int  mPixelInfoDisplayGeneration;
 
   // Member functions ----------------------------------------------------------
   void mousePressEvent(QMouseEvent *event) override;
   void mouseMoveEvent(QMouseEvent *event) override;
   void mouseReleaseEvent(QMouseEvent *event) override;
   void wheelEvent(QWheelEvent *wEvent) override;
+  void leaveEvent(QEvent *event) override;
+
+private slots:
+  void applyWheelZoom();
+  void zoomSettled();
 
 private:
   // Member functions ----------------------------------------------------------
+  void updatePixelInfo(const QPoint &inPos);
+  void clearPixelInfo();
+  void adjustWindowLevel(const QPoint &inDiff);
   void setScrollBarValue(QScrollBar *inBar, int inNewValue);
   void setScrollBarValueDiff(QScrollBar *inBar, int inDiff);
 };
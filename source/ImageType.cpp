@@ -156,6 +156,7 @@ ImageType::ImageType(PixelType inPixelType, BufferType inBufferType, DataType in
             uint32_t inFourCC,
             unsigned int inComponentsPerPixel)
 {
+  invalidate();   // The setters update the descriptor from all the members
   set(inPixelType, inBufferType, inDataType, inEndian,
       inFourCC, inComponentsPerPixel);
 }
@@ -193,54 +194,6 @@ bool ImageType::isValid(bool inAllowAny) const
   return true;
 }
 
-// -----------------------------------------------------------------------------
-// hasMacroPixelStructure
-// -----------------------------------------------------------------------------
-bool ImageType::hasMacroPixelStructure() const
-{
-  return hasMacroPixelStructure(mPixelType, mFourCC);
-}
-
-// -----------------------------------------------------------------------------
-// isPlanar
-// -----------------------------------------------------------------------------
-bool ImageType::isPlanar() const
-{
-  return isPlanar(mBufferType);
-}
-
-// -----------------------------------------------------------------------------
-// isPacked
-// -----------------------------------------------------------------------------
-bool ImageType::isPacked() const
-{
-  return isPacked(mBufferType);
-}
-
-// -----------------------------------------------------------------------------
-// isSigned
-// -----------------------------------------------------------------------------
-bool  ImageType::isSigned() const
-{
-  return isSigned(mDataType);
-}
-
-// -----------------------------------------------------------------------------
-// isByteAligned
-// -----------------------------------------------------------------------------
-bool ImageType::isByteAligned() const
-{
-  return isByteAlgned(mDataType);
-}
-
-// -----------------------------------------------------------------------------
-// sizeOfData
-// -----------------------------------------------------------------------------
-size_t ImageType::sizeOfData() const
-{
-  return sizeOfData(mDataType);
-}
-
 // -----------------------------------------------------------------------------
 // check
 // -----------------------------------------------------------------------------
@@ -261,6 +214,32 @@ void ImageType::invalidate()
   mEndian                 = ImageType::ENDIAN_TYPE_NOT_SPECIFIED;
   mFourCC                 = 0;
   mComponentsPerPixel     = 0;
+  mBitAlign               = ImageType::BIT_ALIGN_LSB;
+  mBitOrder               = ImageType::BIT_ORDER_MSB_FIRST;
+  updateDescriptor();
+}
+
+// -----------------------------------------------------------------------------
+// operator==
+// -----------------------------------------------------------------------------
+bool ImageType::operator==(const ImageType &inType) const
+{
+  return mPixelType == inType.mPixelType &&
+         mBufferType == inType.mBufferType &&
+         mDataType == inType.mDataType &&
+         mEndian == inType.mEndian &&
+         mFourCC == inType.mFourCC &&
+         mComponentsPerPixel == inType.mComponentsPerPixel &&
+         mBitAlign == inType.mBitAlign &&
+         mBitOrder == inType.mBitOrder;
+}
+
+// -----------------------------------------------------------------------------
+// operator!=
+// -----------------------------------------------------------------------------
+bool ImageType::operator!=(const ImageType &inType) const
+{
+  return !(*this == inType);
 }
 
 // -----------------------------------------------------------------------------
@@ -277,6 +256,7 @@ void ImageType::set(PixelType inPixelType, BufferType inBufferType,
   setDataType(inDataType);
   setEndianType(inEndian);
   mFourCC = inFourCC;
+  updateDescriptor();
 }
 
 // -----------------------------------------------------------------------------
@@ -298,6 +278,7 @@ void ImageType::setPixelType(PixelType inPixelType,
     mComponentsPerPixel   = componentsPerPixel(inPixelType);
   else
     mComponentsPerPixel   = inComponentsPerPixel;
+  updateDescriptor();
 }
 
 // -----------------------------------------------------------------------------
@@ -314,6 +295,7 @@ ImageType::BufferType ImageType::bufferType() const
 void ImageType::setBufferType(BufferType inType)
 {
   mBufferType = inType;
+  updateDescriptor();
 }
 
 // -----------------------------------------------------------------------------
@@ -330,6 +312,7 @@ ImageType::DataType ImageType::dataType() const
 void ImageType::setDataType(DataType inType)
 {
   mDataType = inType;
+  updateDescriptor();
 }
 
 // -----------------------------------------------------------------------------
@@ -360,179 +343,94 @@ void ImageType::setEndianType(EndianType inEndian)
 }
 
 // -----------------------------------------------------------------------------
-// fourCC
+// bitAlignType
 // -----------------------------------------------------------------------------
-uint32_t ImageType::fourCC() const
+ImageType::BitAlignType ImageType::bitAlignType() const
 {
-  return mFourCC;
+  return mBitAlign;
 }
 
 // -----------------------------------------------------------------------------
-// setEndianType
+// setBitAlignType
 // -----------------------------------------------------------------------------
-void ImageType::setFourCC(uint32_t inFourCC)
+//  Only meaningful when the bit width is smaller than the container
+//  (10 / 12 / 14-bit data in 16-bit words)
+void ImageType::setBitAlignType(BitAlignType inAlign)
 {
-  mFourCC = inFourCC;
+  mBitAlign = inAlign;
+  updateDescriptor();
 }
 
 // -----------------------------------------------------------------------------
-// componentsPerPixel
+// bitOrderType
 // -----------------------------------------------------------------------------
-unsigned int ImageType::componentsPerPixel() const
+ImageType::BitOrderType ImageType::bitOrderType() const
 {
-  return mComponentsPerPixel;
+  return mBitOrder;
 }
 
 // -----------------------------------------------------------------------------
-// dump
+// setBitOrderType
 // -----------------------------------------------------------------------------
-void ImageType::dump(const char *inLeadingStr)
+//  Only meaningful for the packed 1 and 4-bit data
+void ImageType::setBitOrderType(BitOrderType inOrder)
 {
-  printf("%smPixelType  : 0x%X (%s)\n", inLeadingStr, mPixelType, pixelTypeToString(mPixelType));
-  printf("%smBufferType : 0x%X (%s)\n", inLeadingStr, mBufferType, bufferTypeToString(mBufferType));
-  printf("%smDataType   : 0x%X (%s)\n", inLeadingStr, mDataType, dataTypeToString(mDataType));
-  printf("%smEndian     : 0x%X (%s)\n", inLeadingStr, mEndian, endianTypeToString(mEndian));
-  printf("%smFourCC     : 0x%04X\n", inLeadingStr, mFourCC);
-  printf("%smComponentsPerPixel : %d\n", inLeadingStr, mComponentsPerPixel);
+  mBitOrder = inOrder;
+  updateDescriptor();
 }
 
-// Static Functions ------------------------------------------------------------
 // -----------------------------------------------------------------------------
-// componentsPerPixel
+// fourCC
 // -----------------------------------------------------------------------------
-unsigned int ImageType::componentsPerPixel(PixelType inType)
+uint32_t ImageType::fourCC() const
 {
-  switch (inType)
-  {
-    case ImageType::PIXEL_TYPE_RAW:
-    case ImageType::PIXEL_TYPE_MONO:
-    case ImageType::PIXEL_TYPE_BAYER_GBRG:
-    case ImageType::PIXEL_TYPE_BAYER_GRBG:
-    case ImageType::PIXEL_TYPE_BAYER_BGGR:
-    case ImageType::PIXEL_TYPE_BAYER_RGGB:
-      return 1;
-    case ImageType::PIXEL_TYPE_RGB:
-    case ImageType::PIXEL_TYPE_BGR:
-    case ImageType::PIXEL_TYPE_CMY:
-    case ImageType::PIXEL_TYPE_HSL:
-    case ImageType::PIXEL_TYPE_HSV:
-    case ImageType::PIXEL_TYPE_HSI:
-    case ImageType::PIXEL_TYPE_LUV:
-    case ImageType::PIXEL_TYPE_LAB:
-    case ImageType::PIXEL_TYPE_YUV444:
-      return 3;
-    case ImageType::PIXEL_TYPE_RGBA:
-    case ImageType::PIXEL_TYPE_BGRA:
-    case ImageType::PIXEL_TYPE_CMYK:
-      return 4;
-    default:
-      break;
-  }
-  return 0;
+  return mFourCC;
 }
 
 // -----------------------------------------------------------------------------
-// hasMacroPixelStructure
+// setEndianType
 // -----------------------------------------------------------------------------
-bool ImageType::hasMacroPixelStructure(PixelType inType, uint32_t inFourCC)
+void ImageType::setFourCC(uint32_t inFourCC)
 {
-  switch (inType)
-  {
-    case ImageType::PIXEL_TYPE_YUV410:
-    case ImageType::PIXEL_TYPE_YUV411:
-    case ImageType::PIXEL_TYPE_YUV420:
-    case ImageType::PIXEL_TYPE_YUV422:
-      return true;
-    case ImageType::PIXEL_TYPE_FOURCC:
-      // TODO : We need to check inFourCC here
-      if (inFourCC == 0)
-        return false;
-      break;
-    default:
-      break;
-  }
-  return false;
+  mFourCC = inFourCC;
+  updateDescriptor();
 }
 
 // -----------------------------------------------------------------------------
-// isSigned
+// componentsPerPixel
 // -----------------------------------------------------------------------------
-size_t ImageType::isSigned(DataType inType)
+unsigned int ImageType::componentsPerPixel() const
 {
-  if (inType < 0x1000)
-    return false;
-  return true;
+  return mComponentsPerPixel;
 }
 
 // -----------------------------------------------------------------------------
-// isByteAlgned
+// dump
 // -----------------------------------------------------------------------------
-bool ImageType::isByteAlgned(DataType inType)
+void ImageType::dump(const char *inLeadingStr)
 {
-  switch (inType)
-  {
-    case ImageType::DATA_TYPE_8BIT:
-    case ImageType::DATA_TYPE_8BIT_SIGNED:
-    case ImageType::DATA_TYPE_16BIT:
-    case ImageType::DATA_TYPE_16BIT_SIGNED:
-    case ImageType::DATA_TYPE_24BIT:
-    case ImageType::DATA_TYPE_24BIT_SIGNED:
-    case ImageType::DATA_TYPE_32BIT:
-    case ImageType::DATA_TYPE_32BIT_SIGNED:
-    case ImageType::DATA_TYPE_40BIT:
-    case ImageType::DATA_TYPE_40BIT_SIGNED:
-    case ImageType::DATA_TYPE_48BIT:
-    case ImageType::DATA_TYPE_48BIT_SIGNED:
-    case ImageType::DATA_TYPE_56BIT:
-    case ImageType::DATA_TYPE_56BIT_SIGNED:
-    case ImageType::DATA_TYPE_64BIT:
-    case ImageType::DATA_TYPE_64BIT_SIGNED:
-    case ImageType::DATA_TYPE_FLOAT:
-    case ImageType::DATA_TYPE_DOUBLE:
-      return true;
-    default:
-      break;
-  }
-  return false;
+  printf("%smPixelType  : 0x%X (%s)\n", inLeadingStr, mPixelType, pixelTypeToString(mPixelType));
+  printf("%smBufferType : 0x%X (%s)\n", inLeadingStr, mBufferType, bufferTypeToString(mBufferType));
+  printf("%smDataType   : 0x%X (%s)\n", inLeadingStr, mDataType, dataTypeToString(mDataType));
+  printf("%smEndian     : 0x%X (%s)\n", inLeadingStr, mEndian, endianTypeToString(mEndian));
+  printf("%smFourCC     : 0x%04X\n", inLeadingStr, mFourCC);
+  printf("%smComponentsPerPixel : %d\n", inLeadingStr, mComponentsPerPixel);
+  printf("%smBitAlign   : %s\n", inLeadingStr, mBitAlign == ImageType::BIT_ALIGN_MSB ? "MSB" : "LSB");
+  printf("%smBitOrder   : %s\n", inLeadingStr,
+         mBitOrder == ImageType::BIT_ORDER_LSB_FIRST ? "LSB first" : "MSB first");
 }
 
 // -----------------------------------------------------------------------------
-// sizeOfData
+// updateDescriptor
 // -----------------------------------------------------------------------------
-size_t ImageType::sizeOfData(DataType inType)
+//  The components per pixel given to setPixelType() take precedence
+void ImageType::updateDescriptor()
 {
-  switch (inType)
-  {
-    case ImageType::DATA_TYPE_8BIT:
-    case ImageType::DATA_TYPE_8BIT_SIGNED:
-      return 1;
-    case ImageType::DATA_TYPE_16BIT:
-    case ImageType::DATA_TYPE_16BIT_SIGNED:
-      return 2;
-    case ImageType::DATA_TYPE_24BIT:
-    case ImageType::DATA_TYPE_24BIT_SIGNED:
-      return 3;
-    case ImageType::DATA_TYPE_32BIT:
-    case ImageType::DATA_TYPE_32BIT_SIGNED:
-      return 4;
-    case ImageType::DATA_TYPE_40BIT:
-    case ImageType::DATA_TYPE_40BIT_SIGNED:
-      return 5;
-    case ImageType::DATA_TYPE_48BIT:
-    case ImageType::DATA_TYPE_48BIT_SIGNED:
-      return 6;
-    case ImageType::DATA_TYPE_56BIT:
-    case ImageType::DATA_TYPE_56BIT_SIGNED:
-      return 7;
-    case ImageType::DATA_TYPE_64BIT:
-    case ImageType::DATA_TYPE_64BIT_SIGNED:
-      return 8;
-    default:
-      break;
-  }
-  return 0;
+  mDescriptor = makeDescriptor(mPixelType, mBufferType, mDataType, mFourCC, mComponentsPerPixel,
+                               mBitAlign, mBitOrder);
 }
 
+// Static Functions ------------------------------------------------------------
 // -----------------------------------------------------------------------------
 // dataTypeFromParams
 // -----------------------------------------------------------------------------
@@ -589,28 +487,6 @@ ImageType::DataType ImageType::dataTypeFromParams(unsigned int inBitWidth,
   return type;
 }
 
-// -----------------------------------------------------------------------------
-// isPlanar
-// -----------------------------------------------------------------------------
-bool ImageType::isPlanar(BufferType inBufferType)
-{
-  if (inBufferType == ImageType::BUFFER_TYPE_PLANAR_ALIGNED ||
-      inBufferType == ImageType::BUFFER_TYPE_PLANAR_PACKED)
-    return true;
-  return false;
-}
-
-// -----------------------------------------------------------------------------
-// isPacked
-// -----------------------------------------------------------------------------
-bool ImageType::isPacked(BufferType inBufferType)
-{
-  if (inBufferType == ImageType::BUFFER_TYPE_PIXEL_PACKED ||
-      inBufferType == ImageType::BUFFER_TYPE_PLANAR_PACKED)
-    return true;
-  return false;
-}
-
 // -----------------------------------------------------------------------------
 // check
 // -----------------------------------------------------------------------------
@@ -631,7 +507,8 @@ bool ImageType::check(const ImageType &inType, PixelType inPixelType,
 // -----------------------------------------------------------------------------
 ImageType::EndianType ImageType::getHostEndian()
 {
-#ifdef __LITTLE_ENDIAN__
+#if defined(__LITTLE_ENDIAN__) || defined(_WIN32) || \
+    (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
     return ImageType::ENDIAN_LITTLE;
 #else
     return ImageType::ENDIAN_BIG;
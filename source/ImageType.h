@@ -145,6 +145,18 @@ public:
     ENDIAN_TYPE_ANY           = 0xFFFF
   };
 
+  enum  BitAlignType      // N-bit data in a larger container (e.g. 12-bit in 16-bit words)
+  {
+    BIT_ALIGN_LSB             = 0,  // In the low bits (default)
+    BIT_ALIGN_MSB                   // In the high bits (full scale is the container's)
+  };
+
+  enum  BitOrderType      // Bit stream of the packed components (not CSI-2)
+  {
+    BIT_ORDER_MSB_FIRST       = 0,  // The first pixel in the high bits (default, e.g. PBM)
+    BIT_ORDER_LSB_FIRST             // The first pixel in the low bits (e.g. XBM, Mono10p)
+  };
+
   enum  ChannelType       // We are not using this for now...
   {
     CH_TYPE_NOT_SPECIFIED   = 0,
@@ -186,6 +198,31 @@ public:
     CH_TYPE_ANY             = 0xFFFF
   };
 
+  // Properties of a type needed by the per row code. Made once when the type
+  // is set (see makeDescriptor(), which can also be used in constant expressions)
+  struct Descriptor
+  {
+    uint8_t   bitsPerComponent;       // Significant bits (0 : unknown)
+    uint8_t   bytesPerComponent;      // Container of a component (0 : unknown)
+    uint8_t   valueShift;             // Right shift from the container to the value (MSB aligned)
+    uint16_t  componentsPerPixel;
+    uint16_t  bytesPerPixel;          // Pixel step of a plane (0 : packed or macro pixel)
+    uint8_t   macroPixelWidth;        // Pixels sharing the components (1 : none)
+    uint8_t   macroPixelHeight;
+    int8_t    redIndex;               // Component order (-1 : none)
+    int8_t    greenIndex;
+    int8_t    blueIndex;
+    int8_t    alphaIndex;
+    bool      isSigned;
+    bool      isFloat;
+    bool      isByteAligned;
+    bool      isPlanar;
+    bool      isPacked;
+    bool      isCsi2Packed;           // Groups of MIPI CSI-2 RAW data (see ImageFormat)
+    bool      isLsbFirst;             // Bit order of the packed pixels
+    bool      hasMacroPixelStructure;
+  };
+
   // Constructors and Destructor -----------------------------------------------
   ImageType();
   ImageType(PixelType inPixelType, BufferType inBufferType, DataType inDataType,
@@ -201,13 +238,20 @@ public:
   bool isPacked() const;
   bool isSigned() const;
   bool isByteAligned() const;
+  bool isFloat() const;
   size_t sizeOfData() const;
+  unsigned int bitsPerComponent() const;
+  const Descriptor &descriptor() const;
   bool check(PixelType inPixelType, BufferType inBufferType, DataType inDataType) const;
   void invalidate();
+  bool operator==(const ImageType &inType) const;
+  bool operator!=(const ImageType &inType) const;
   PixelType pixelType() const;
   BufferType bufferType() const;
   DataType dataType() const;
   EndianType endianType() const;
+  BitAlignType bitAlignType() const;
+  BitOrderType bitOrderType() const;
   uint32_t fourCC() const;
   unsigned int componentsPerPixel() const;
 
@@ -220,19 +264,29 @@ public:
   void setDataType(DataType inType);
   void setDataType(unsigned int inBitWidth, bool inIsSigned = false);
   void setEndianType(EndianType inEndian = ENDIAN_TYPE_HOST);
+  void setBitAlignType(BitAlignType inAlign);
+  void setBitOrderType(BitOrderType inOrder);
   void setFourCC(uint32_t inFourCC);
 
   void dump(const char *inLeadingStr = "");
 
   // Static Functions ----------------------------------------------------------
-  static unsigned int componentsPerPixel(PixelType inType);
-  static bool hasMacroPixelStructure(PixelType inType, uint32_t inFourCC = 0);
-  static size_t isSigned(DataType inType);
-  static bool isByteAlgned(DataType inType);
-  static size_t sizeOfData(DataType inType);
+  static constexpr unsigned int componentsPerPixel(PixelType inType);
+  static constexpr bool hasMacroPixelStructure(PixelType inType, uint32_t inFourCC = 0);
+  static constexpr size_t isSigned(DataType inType);
+  static constexpr bool isByteAlgned(DataType inType);
+  static constexpr bool isFloat(DataType inType);
+  static constexpr size_t sizeOfData(DataType inType);
+  static constexpr unsigned int bitsPerComponent(DataType inType);
   static DataType dataTypeFromParams(unsigned int inBitWidth, bool inIsSigned = false);
-  static bool isPlanar(BufferType inBufferType);
-  static bool isPacked(BufferType inBufferType);
+  static constexpr bool isPlanar(BufferType inBufferType);
+  static constexpr bool isPacked(BufferType inBufferType);
+  static constexpr bool isCsi2Packed(BufferType inBufferType);
+  static constexpr Descriptor makeDescriptor(PixelType inPixelType, BufferType inBufferType,
+                                             DataType inDataType, uint32_t inFourCC = 0,
+                                             unsigned int inComponentsPerPixel = 0,
+                                             BitAlignType inBitAlign = BIT_ALIGN_LSB,
+                                             BitOrderType inBitOrder = BIT_ORDER_MSB_FIRST);
   static bool check(const ImageType &inType, PixelType inPixelType, BufferType inBufferType, DataType inDataType);
   static EndianType getHostEndian();
   static const char *pixelTypeToString(PixelType inType);
@@ -252,6 +306,381 @@ private:
   EndianType      mEndian;
   uint32_t        mFourCC;
   unsigned int    mComponentsPerPixel;
+  BitAlignType    mBitAlign;
+  BitOrderType    mBitOrder;
+  Descriptor      mDescriptor;
+
+  // Member functions ----------------------------------------------------------
+  void  updateDescriptor();
 };
 
+// Inline functions ------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// hasMacroPixelStructure
+// -----------------------------------------------------------------------------
+inline bool ImageType::hasMacroPixelStructure() const
+{
+  return mDescriptor.hasMacroPixelStructure;
+}
+
+// -----------------------------------------------------------------------------
+// isPlanar
+// -----------------------------------------------------------------------------
+inline bool ImageType::isPlanar() const
+{
+  return mDescriptor.isPlanar;
+}
+
+// -----------------------------------------------------------------------------
+// isPacked
+// -----------------------------------------------------------------------------
+inline bool ImageType::isPacked() const
+{
+  return mDescriptor.isPacked;
+}
+
+// -----------------------------------------------------------------------------
+// isSigned
+// -----------------------------------------------------------------------------
+inline bool ImageType::isSigned() const
+{
+  return mDescriptor.isSigned;
+}
+
+// -----------------------------------------------------------------------------
+// isByteAligned
+// -----------------------------------------------------------------------------
+inline bool ImageType::isByteAligned() const
+{
+  return mDescriptor.isByteAligned;
+}
+
+// -----------------------------------------------------------------------------
+// isFloat
+// -----------------------------------------------------------------------------
+inline bool ImageType::isFloat() const
+{
+  return mDescriptor.isFloat;
+}
+
+// -----------------------------------------------------------------------------
+// sizeOfData
+// -----------------------------------------------------------------------------
+inline size_t ImageType::sizeOfData() const
+{
+  return mDescriptor.bytesPerComponent;
+}
+
+// -----------------------------------------------------------------------------
+// bitsPerComponent
+// -----------------------------------------------------------------------------
+inline unsigned int ImageType::bitsPerComponent() const
+{
+  return mDescriptor.bitsPerComponent;
+}
+
+// -----------------------------------------------------------------------------
+// descriptor
+// -----------------------------------------------------------------------------
+inline const ImageType::Descriptor &ImageType::descriptor() const
+{
+  return mDescriptor;
+}
+
+// Static Functions ------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// componentsPerPixel
+// -----------------------------------------------------------------------------
+constexpr unsigned int ImageType::componentsPerPixel(PixelType inType)
+{
+  switch (inType)
+  {
+    case ImageType::PIXEL_TYPE_RAW:
+    case ImageType::PIXEL_TYPE_MONO:
+    case ImageType::PIXEL_TYPE_BAYER_GBRG:
+    case ImageType::PIXEL_TYPE_BAYER_GRBG:
+    case ImageType::PIXEL_TYPE_BAYER_BGGR:
+    case ImageType::PIXEL_TYPE_BAYER_RGGB:
+      return 1;
+    case ImageType::PIXEL_TYPE_RGB:
+    case ImageType::PIXEL_TYPE_BGR:
+    case ImageType::PIXEL_TYPE_CMY:
+    case ImageType::PIXEL_TYPE_HSL:
+    case ImageType::PIXEL_TYPE_HSV:
+    case ImageType::PIXEL_TYPE_HSI:
+    case ImageType::PIXEL_TYPE_LUV:
+    case ImageType::PIXEL_TYPE_LAB:
+    case ImageType::PIXEL_TYPE_YUV444:
+      return 3;
+    case ImageType::PIXEL_TYPE_RGBA:
+    case ImageType::PIXEL_TYPE_ARGB:
+    case ImageType::PIXEL_TYPE_BGRA:
+    case ImageType::PIXEL_TYPE_ABGR:
+    case ImageType::PIXEL_TYPE_CMYK:
+      return 4;
+    default:
+      break;
+  }
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+// hasMacroPixelStructure
+// -----------------------------------------------------------------------------
+constexpr bool ImageType::hasMacroPixelStructure(PixelType inType, uint32_t inFourCC)
+{
+  switch (inType)
+  {
+    case ImageType::PIXEL_TYPE_YUV410:
+    case ImageType::PIXEL_TYPE_YUV411:
+    case ImageType::PIXEL_TYPE_YUV420:
+    case ImageType::PIXEL_TYPE_YUV422:
+      return true;
+    case ImageType::PIXEL_TYPE_FOURCC:
+      // TODO : We need to check inFourCC here
+      if (inFourCC == 0)
+        return false;
+      break;
+    default:
+      break;
+  }
+  return false;
+}
+
+// -----------------------------------------------------------------------------
+// isSigned
+// -----------------------------------------------------------------------------
+constexpr size_t ImageType::isSigned(DataType inType)
+{
+  if (inType < 0x1000)
+    return false;
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// isByteAlgned
+// -----------------------------------------------------------------------------
+constexpr bool ImageType::isByteAlgned(DataType inType)
+{
+  switch (inType)
+  {
+    case ImageType::DATA_TYPE_8BIT:
+    case ImageType::DATA_TYPE_8BIT_SIGNED:
+    case ImageType::DATA_TYPE_16BIT:
+    case ImageType::DATA_TYPE_16BIT_SIGNED:
+    case ImageType::DATA_TYPE_24BIT:
+    case ImageType::DATA_TYPE_24BIT_SIGNED:
+    case ImageType::DATA_TYPE_32BIT:
+    case ImageType::DATA_TYPE_32BIT_SIGNED:
+    case ImageType::DATA_TYPE_40BIT:
+    case ImageType::DATA_TYPE_40BIT_SIGNED:
+    case ImageType::DATA_TYPE_48BIT:
+    case ImageType::DATA_TYPE_48BIT_SIGNED:
+    case ImageType::DATA_TYPE_56BIT:
+    case ImageType::DATA_TYPE_56BIT_SIGNED:
+    case ImageType::DATA_TYPE_64BIT:
+    case ImageType::DATA_TYPE_64BIT_SIGNED:
+    case ImageType::DATA_TYPE_FLOAT:
+    case ImageType::DATA_TYPE_DOUBLE:
+      return true;
+    default:
+      break;
+  }
+  return false;
+}
+
+// -----------------------------------------------------------------------------
+// isFloat
+// -----------------------------------------------------------------------------
+constexpr bool ImageType::isFloat(DataType inType)
+{
+  return inType == ImageType::DATA_TYPE_FLOAT || inType == ImageType::DATA_TYPE_DOUBLE;
+}
+
+// -----------------------------------------------------------------------------
+// sizeOfData
+// -----------------------------------------------------------------------------
+//  The container size of a pixel aligned component. 1 and 4-bit data take a
+//  byte, 10 to 14-bit data a 16-bit word
+constexpr size_t ImageType::sizeOfData(DataType inType)
+{
+  switch (inType)
+  {
+    case ImageType::DATA_TYPE_1BIT:
+    case ImageType::DATA_TYPE_4BIT:
+    case ImageType::DATA_TYPE_4BIT_SIGNED:
+    case ImageType::DATA_TYPE_8BIT:
+    case ImageType::DATA_TYPE_8BIT_SIGNED:
+      return 1;
+    case ImageType::DATA_TYPE_10BIT:
+    case ImageType::DATA_TYPE_10BIT_SIGNED:
+    case ImageType::DATA_TYPE_12BIT:
+    case ImageType::DATA_TYPE_12BIT_SIGNED:
+    case ImageType::DATA_TYPE_14BIT:
+    case ImageType::DATA_TYPE_14BIT_SIGNED:
+    case ImageType::DATA_TYPE_16BIT:
+    case ImageType::DATA_TYPE_16BIT_SIGNED:
+      return 2;
+    case ImageType::DATA_TYPE_24BIT:
+    case ImageType::DATA_TYPE_24BIT_SIGNED:
+      return 3;
+    case ImageType::DATA_TYPE_32BIT:
+    case ImageType::DATA_TYPE_32BIT_SIGNED:
+    case ImageType::DATA_TYPE_FLOAT:
+      return 4;
+    case ImageType::DATA_TYPE_40BIT:
+    case ImageType::DATA_TYPE_40BIT_SIGNED:
+      return 5;
+    case ImageType::DATA_TYPE_48BIT:
+    case ImageType::DATA_TYPE_48BIT_SIGNED:
+      return 6;
+    case ImageType::DATA_TYPE_56BIT:
+    case ImageType::DATA_TYPE_56BIT_SIGNED:
+      return 7;
+    case ImageType::DATA_TYPE_64BIT:
+    case ImageType::DATA_TYPE_64BIT_SIGNED:
+    case ImageType::DATA_TYPE_DOUBLE:
+      return 8;
+    default:
+      break;
+  }
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+// bitsPerComponent
+// -----------------------------------------------------------------------------
+constexpr unsigned int ImageType::bitsPerComponent(DataType inType)
+{
+  if (inType == ImageType::DATA_TYPE_FLOAT)
+    return 32;
+  if (inType == ImageType::DATA_TYPE_DOUBLE)
+    return 64;
+  if (sizeOfData(inType) == 0)
+    return 0;
+  if (isSigned(inType))
+    return (unsigned int )inType - (unsigned int )ImageType::DATA_TYPE_SIGNED_OFFSET;
+  return (unsigned int )inType;
+}
+
+// -----------------------------------------------------------------------------
+// isPlanar
+// -----------------------------------------------------------------------------
+constexpr bool ImageType::isPlanar(BufferType inBufferType)
+{
+  if (inBufferType == ImageType::BUFFER_TYPE_PLANAR_ALIGNED ||
+      inBufferType == ImageType::BUFFER_TYPE_PLANAR_PACKED ||
+      inBufferType == ImageType::BUFFER_TYPE_PLANAR_PACKED_CSI_2)
+    return true;
+  return false;
+}
+
+// -----------------------------------------------------------------------------
+// isPacked
+// -----------------------------------------------------------------------------
+constexpr bool ImageType::isPacked(BufferType inBufferType)
+{
+  if (inBufferType == ImageType::BUFFER_TYPE_PIXEL_PACKED ||
+      inBufferType == ImageType::BUFFER_TYPE_PLANAR_PACKED ||
+      inBufferType == ImageType::BUFFER_TYPE_LINE_INTERLEAVE_PACKED ||
+      inBufferType == ImageType::BUFFER_TYPE_INTRA_LINE_PACKED)
+    return true;
+  return isCsi2Packed(inBufferType);
+}
+
+// -----------------------------------------------------------------------------
+// isCsi2Packed
+// -----------------------------------------------------------------------------
+constexpr bool ImageType::isCsi2Packed(BufferType inBufferType)
+{
+  if (inBufferType == ImageType::BUFFER_TYPE_PIXEL_PACKED_CSI_2 ||
+      inBufferType == ImageType::BUFFER_TYPE_PLANAR_PACKED_CSI_2 ||
+      inBufferType == ImageType::BUFFER_TYPE_LINE_INTERLEAVE_PACKED_CSI_2 ||
+      inBufferType == ImageType::BUFFER_TYPE_INTRA_LINE_PACKED_CSI_2)
+    return true;
+  return false;
+}
+
+// -----------------------------------------------------------------------------
+// makeDescriptor
+// -----------------------------------------------------------------------------
+//  inComponentsPerPixel == 0 takes the number of inPixelType
+constexpr ImageType::Descriptor ImageType::makeDescriptor(PixelType inPixelType,
+                                                          BufferType inBufferType,
+                                                          DataType inDataType, uint32_t inFourCC,
+                                                          unsigned int inComponentsPerPixel,
+                                                          BitAlignType inBitAlign,
+                                                          BitOrderType inBitOrder)
+{
+  Descriptor  desc = {};
+  desc.bitsPerComponent   = (uint8_t )bitsPerComponent(inDataType);
+  desc.bytesPerComponent  = (uint8_t )sizeOfData(inDataType);
+  desc.componentsPerPixel = (uint16_t )(inComponentsPerPixel != 0 ?
+                                       inComponentsPerPixel : componentsPerPixel(inPixelType));
+  if (inBitAlign == ImageType::BIT_ALIGN_MSB && desc.bitsPerComponent != 0 &&
+      desc.bitsPerComponent < desc.bytesPerComponent * 8)
+    desc.valueShift = (uint8_t )(desc.bytesPerComponent * 8 - desc.bitsPerComponent);
+  desc.isSigned       = isSigned(inDataType);
+  desc.isFloat        = isFloat(inDataType);
+  desc.isByteAligned  = isByteAlgned(inDataType);
+  desc.isPlanar       = isPlanar(inBufferType);
+  desc.isPacked       = isPacked(inBufferType);
+  desc.isCsi2Packed   = isCsi2Packed(inBufferType);
+  desc.isLsbFirst     = (inBitOrder == ImageType::BIT_ORDER_LSB_FIRST);
+  desc.hasMacroPixelStructure = hasMacroPixelStructure(inPixelType, inFourCC);
+
+  // The same step as ImageFormat::set() makes by default
+  if (desc.isPacked == false && desc.hasMacroPixelStructure == false)
+    desc.bytesPerPixel = (uint16_t )(desc.isPlanar ? desc.bytesPerComponent :
+                                    desc.bytesPerComponent * desc.componentsPerPixel);
+
+  desc.macroPixelWidth  = 1;
+  desc.macroPixelHeight = 1;
+  switch (inPixelType)
+  {
+    case ImageType::PIXEL_TYPE_YUV410:
+      desc.macroPixelWidth = 4; desc.macroPixelHeight = 4;
+      break;
+    case ImageType::PIXEL_TYPE_YUV411:
+      desc.macroPixelWidth = 4;
+      break;
+    case ImageType::PIXEL_TYPE_YUV420:
+      desc.macroPixelWidth = 2; desc.macroPixelHeight = 2;
+      break;
+    case ImageType::PIXEL_TYPE_YUV422:
+      desc.macroPixelWidth = 2;
+      break;
+    default:
+      break;
+  }
+
+  desc.redIndex = desc.greenIndex = desc.blueIndex = desc.alphaIndex = -1;
+  switch (inPixelType)
+  {
+    case ImageType::PIXEL_TYPE_RGB:
+    case ImageType::PIXEL_TYPE_MULTI_CH_RGB:
+      desc.redIndex = 0; desc.greenIndex = 1; desc.blueIndex = 2;
+      break;
+    case ImageType::PIXEL_TYPE_BGR:
+      desc.redIndex = 2; desc.greenIndex = 1; desc.blueIndex = 0;
+      break;
+    case ImageType::PIXEL_TYPE_RGBA:
+    case ImageType::PIXEL_TYPE_MULTI_CH_RGBA:
+      desc.redIndex = 0; desc.greenIndex = 1; desc.blueIndex = 2; desc.alphaIndex = 3;
+      break;
+    case ImageType::PIXEL_TYPE_ARGB:
+      desc.redIndex = 1; desc.greenIndex = 2; desc.blueIndex = 3; desc.alphaIndex = 0;
+      break;
+    case ImageType::PIXEL_TYPE_BGRA:
+      desc.redIndex = 2; desc.greenIndex = 1; desc.blueIndex = 0; desc.alphaIndex = 3;
+      break;
+    case ImageType::PIXEL_TYPE_ABGR:
+      desc.redIndex = 3; desc.greenIndex = 2; desc.blueIndex = 1; desc.alphaIndex = 0;
+      break;
+    default:
+      break;
+  }
+  return desc;
+}
+
 #endif //QIV_IMAGE_TYPE_H
@@ -27,11 +27,26 @@
 ImageView::ImageView(QWidget *parent, Qt::WindowFlags flags) :
         QWidget(parent, flags),
         mImageData(nullptr),
+        mOverlayData(nullptr),
         mZoomScale(1.0),
-        mImageSizeChangedFlag(false)
+        mImageSizeChangedFlag(false),
+        mInterimRenderingFlag(false),
+        mFrameGeneration(0),
+        mTransform(ImageScaler::TRANSFORM_NONE),
+        mColorMapIndex(ColorMap::CMI_ANY)
 {
 }
 
+// -----------------------------------------------------------------------------
+// ~ImageView
+// -----------------------------------------------------------------------------
+//  The cache is owned by the views (ImageData only keeps weak references), so
+//  this is safe even after the ImageData is gone
+ImageView::~ImageView()
+{
+  releaseRenderCache();
+}
+
 // -------------------------------------------------------------------------
 // setImageData
 // -------------------------------------------------------------------------
@@ -39,26 +54,191 @@ void ImageView::setImageData(ImageData *inImageData)
 {
   if (mImageData != nullptr)
     mImageData->removeWidget(this);
+  releaseRenderCache();
   mImageData = inImageData;
   mImageData->addWidget(this);
   updateSizeUsingImageData();
 }
 
 // -------------------------------------------------------------------------
-// updateWidget (from ViewDataInterface class)
+// getImageData
+// -------------------------------------------------------------------------
+ImageData *ImageView::getImageData()
+{
+  return mImageData;
+}
+
+// -------------------------------------------------------------------------
+// setOverlayData
 // -------------------------------------------------------------------------
-void ImageView::updateWidget()
+//  inOverlayData (e.g. a 1-bit mask of the same size with an overlay color)
+//  is drawn over the image, nullptr removes it. As with setImageData(), set
+//  nullptr before the ImageData is deleted
+void ImageView::setOverlayData(ImageData *inOverlayData)
 {
+  if (mOverlayData == inOverlayData)
+    return;
+  if (mOverlayData != nullptr)
+    mOverlayData->removeWidget(this);
+  releaseRenderCache();
+  mOverlayData = inOverlayData;
+  if (mOverlayData != nullptr)
+    mOverlayData->addWidget(this);
   update();
 }
 
+// -------------------------------------------------------------------------
+// getOverlayData
+// -------------------------------------------------------------------------
+ImageData *ImageView::getOverlayData()
+{
+  return mOverlayData;
+}
+
+// -------------------------------------------------------------------------
+// mapToImage
+// -------------------------------------------------------------------------
+bool ImageView::mapToImage(const QPoint &inPos, unsigned int *outX, unsigned int *outY) const
+{
+  if (mImageData == nullptr)
+    return false;
+  QPoint  pos = ImageScaler::inverseTransformRect(QRect(inPos.x(), inPos.y(), 1, 1),
+                                                  getZoomedSize(), mTransform).topLeft();
+  if (pos.x() < 0 || pos.y() < 0)
+    return false;
+
+  unsigned int x = (unsigned int )(pos.x() / mZoomScale);
+  unsigned int y = (unsigned int )(pos.y() / mZoomScale);
+  if (x >= mImageData->getFormat().width() || y >= mImageData->getFormat().height())
+    return false;
+
+  *outX = x;
+  *outY = y;
+  return true;
+}
+
+// -------------------------------------------------------------------------
+// mapToImageRect
+// -------------------------------------------------------------------------
+//  Returns the image area (clipped) needed to draw inRect of this widget
+QRect ImageView::mapToImageRect(const QRect &inRect) const
+{
+  if (mImageData == nullptr)
+    return QRect();
+
+  QRect zoomedRect = ImageScaler::inverseTransformRect(inRect, getZoomedSize(), mTransform);
+  int x0 = (int )floor(zoomedRect.left() / mZoomScale);
+  int y0 = (int )floor(zoomedRect.top() / mZoomScale);
+  int x1 = (int )ceil((zoomedRect.right() + 1) / mZoomScale);
+  int y1 = (int )ceil((zoomedRect.bottom() + 1) / mZoomScale);
+  QRect imageRect(0, 0, (int )mImageData->getFormat().width(), (int )mImageData->getFormat().height());
+  return QRect(x0, y0, x1 - x0, y1 - y0).intersected(imageRect);
+}
+
+// -------------------------------------------------------------------------
+// mapFromImageRect
+// -------------------------------------------------------------------------
+//  Returns the area of this widget that shows inRect of the image
+QRect ImageView::mapFromImageRect(const QRect &inRect) const
+{
+  if (inRect.isEmpty())
+    return QRect();
+  int x0 = (int )floor(inRect.left() * mZoomScale);
+  int y0 = (int )floor(inRect.top() * mZoomScale);
+  int x1 = (int )ceil((inRect.right() + 1) * mZoomScale);
+  int y1 = (int )ceil((inRect.bottom() + 1) * mZoomScale);
+  return ImageScaler::transformRect(QRect(x0, y0, x1 - x0, y1 - y0), getZoomedSize(),
+                                    mTransform).intersected(rect());
+}
+
+// -------------------------------------------------------------------------
+// mapToImagePos
+// -------------------------------------------------------------------------
+//  Widget position -> image position (not clipped, in source pixels)
+QPointF ImageView::mapToImagePos(const QPointF &inPos) const
+{
+  QSize size = ImageScaler::transformSize(getZoomedSize(), mTransform);
+  double  x = inPos.x();
+  double  y = inPos.y();
+  if (ImageScaler::isFlippedHorizontally(mTransform))
+    x = size.width() - x;
+  if (ImageScaler::isFlippedVertically(mTransform))
+    y = size.height() - y;
+  if (ImageScaler::isTransposed(mTransform))
+    std::swap(x, y);
+  return QPointF(x / mZoomScale, y / mZoomScale);
+}
+
+// -------------------------------------------------------------------------
+// mapFromImagePos
+// -------------------------------------------------------------------------
+//  Image position -> widget position (the inverse of mapToImagePos())
+QPointF ImageView::mapFromImagePos(const QPointF &inPos) const
+{
+  QSize size = ImageScaler::transformSize(getZoomedSize(), mTransform);
+  double  x = inPos.x() * mZoomScale;
+  double  y = inPos.y() * mZoomScale;
+  if (ImageScaler::isTransposed(mTransform))
+    std::swap(x, y);
+  if (ImageScaler::isFlippedHorizontally(mTransform))
+    x = size.width() - x;
+  if (ImageScaler::isFlippedVertically(mTransform))
+    y = size.height() - y;
+  return QPointF(x, y);
+}
+
+// -------------------------------------------------------------------------
+// getFrameGeneration
+// -------------------------------------------------------------------------
+uint64_t ImageView::getFrameGeneration() const
+{
+  return mFrameGeneration;
+}
+
+// -------------------------------------------------------------------------
+// updateWidget (from ViewDataInterface class)
+// -------------------------------------------------------------------------
+//  Called (in the GUI thread, at most once per present) when the displayed
+//  data is changed (new frame, window / level or colormap). Only the dirty
+//  area is repainted, QWidget::update() merges it with the pending ones into
+//  one paint event. The render cache sees the change from
+//  ImageData::getDisplayGeneration()
+void ImageView::updateWidget(const ImageData *inImageData, const QRect &inDirtyRect,
+                             uint64_t inFrameGeneration)
+{
+  if (inImageData == mImageData)
+    mFrameGeneration = inFrameGeneration;   // Not of the overlay
+  if (mImageSizeChangedFlag)
+  {
+    update();   // Resized at the paint (rect() is of the old size)
+    return;
+  }
+  QRect dirtyRect = mapFromImageRect(inDirtyRect);
+  if (dirtyRect.isEmpty())
+    return;
+  update(dirtyRect);
+}
+
 // -------------------------------------------------------------------------
 // setImageSizeChangedFlag (from ViewDataInterface class)
 // -------------------------------------------------------------------------
 void ImageView::setImageSizeChangedFlag(bool inFlag)
 {
+  // The repaint comes from updateWidget() (at the next present)
   mImageSizeChangedFlag = inFlag;
-  update();
+}
+
+// -------------------------------------------------------------------------
+// getVisibleImageRect (from ViewDataInterface class)
+// -------------------------------------------------------------------------
+//  The visible area + the margin the render cache covers around it
+QRect ImageView::getVisibleImageRect() const
+{
+  QRect visibleRect = visibleRegion().boundingRect();
+  if (visibleRect.isEmpty())
+    return QRect();
+  int margin = RenderCache::CACHE_MARGIN;
+  return mapToImageRect(visibleRect.adjusted(-margin, -margin, margin, margin).intersected(rect()));
 }
 
 // -------------------------------------------------------------------------
@@ -83,14 +263,71 @@ void ImageView::setZoomScale(double inScale)
     inScale = 0.01;
   mZoomScale = inScale;
 
-  double scale = mZoomScale;
-  int width = (int )(mImageData->getFormat().width() * scale);
-  int height = (int )(mImageData->getFormat().height() * scale);
-  resize(width, height);
+  // Rounded as the scaler does (see getZoomedSize()), the view transforms
+  // map the image to this size
+  resize(ImageScaler::transformSize(getZoomedSize(), mTransform));
 
   mZoomScale = inScale;
 }
 
+// -------------------------------------------------------------------------
+// setColorMap
+// -------------------------------------------------------------------------
+//  A colormap for this view only (CMI_ANY : follow the ImageData). Only the
+//  render cache is changed, the display image is shared with the other views
+void ImageView::setColorMap(ColorMap::ColorMapIndex inIndex)
+{
+  if (mColorMapIndex == inIndex)
+    return;
+  mColorMapIndex = inIndex;
+  update();
+}
+
+// -------------------------------------------------------------------------
+// getColorMap
+// -------------------------------------------------------------------------
+ColorMap::ColorMapIndex ImageView::getColorMap() const
+{
+  return mColorMapIndex;
+}
+
+// -------------------------------------------------------------------------
+// setInterimRendering
+// -------------------------------------------------------------------------
+//  true renders with the nearest filter only (the intermediate scales of a
+//  zoom gesture), false renders the current scale again at full quality
+void ImageView::setInterimRendering(bool inFlag)
+{
+  if (mInterimRenderingFlag == inFlag)
+    return;
+  mInterimRenderingFlag = inFlag;
+  update();
+}
+
+// -------------------------------------------------------------------------
+// setViewTransform
+// -------------------------------------------------------------------------
+//  Flips or rotates the view (the renderer reads the display image mirrored
+//  or transposed, the image is not modified). The image coordinates
+//  (mapToImage() etc.) are not affected. The widget is resized when the
+//  width and height are swapped
+void ImageView::setViewTransform(ImageScaler::Transform inTransform)
+{
+  if (mTransform == inTransform)
+    return;
+  mTransform = inTransform;
+  updateSizeUsingImageData();
+  update();
+}
+
+// -------------------------------------------------------------------------
+// getViewTransform
+// -------------------------------------------------------------------------
+ImageScaler::Transform ImageView::getViewTransform() const
+{
+  return mTransform;
+}
+
 // -------------------------------------------------------------------------
 // calcZoomScale
 // -------------------------------------------------------------------------
@@ -124,7 +361,7 @@ bool ImageView::updateSizeUsingImageData()
 // -----------------------------------------------------------------------------
 // paintEvent
 // -----------------------------------------------------------------------------
-void ImageView::paintEvent([[maybe_unused]] QPaintEvent *event)
+void ImageView::paintEvent(QPaintEvent *event)
 {
   if (mImageData == nullptr)
     return;
@@ -136,10 +373,110 @@ void ImageView::paintEvent([[maybe_unused]] QPaintEvent *event)
     mImageSizeChangedFlag = false;
   }
 
-  mImageData->update();
-  QRect rect(0, 0, size().width(), size().height());
+  // The conversion runs in the background (the widget is redrawn when it
+  // completes), the latest completed display image is drawn here
+  mImageData->startConversion();
+
+  // The scaled pixels come from the render cache shared by the views with
+  // the same zoom and colormap. Panning only renders the strips that scroll
+  // into it (see RenderCache::update())
+  QRect exposedRect = event->rect().intersected(rect());
+  if (exposedRect.isEmpty())
+    return;
   QPainter painter(this);
-  mImageData->draw(painter, rect);
+  RenderCache *cache = getRenderCache(mImageData, &mRenderCache);
+  cache->setVisibleRect(this, visibleRegion().boundingRect());
+  if (cache->update(*mImageData, this, exposedRect, rect()))
+    cache->draw(painter, exposedRect);
+  else
+  {
+    // Map the exposed area back to the source pixels that cover it. Only that
+    // part is drawn
+    QRect sourceRect = mapToImageRect(exposedRect);
+    if (sourceRect.isEmpty())
+      return;
+    QRectF targetRect(sourceRect.x() * mZoomScale, sourceRect.y() * mZoomScale,
+                      sourceRect.width() * mZoomScale, sourceRect.height() * mZoomScale);
+    painter.save();
+    painter.setTransform(ImageScaler::getPainterTransform(getZoomedSize(), mTransform));
+    mImageData->draw(painter, targetRect, sourceRect);
+    painter.restore();
+  }
+  drawOverlay(painter, exposedRect);
   //painter.drawText(rect, Qt::AlignCenter, "Hello, world");
 }
 
+// -----------------------------------------------------------------------------
+// drawOverlay
+// -----------------------------------------------------------------------------
+//  The overlay (e.g. an Indexed8 mask with a transparent color table entry)
+//  has its own render cache, which keeps the alpha of the color table. Only
+//  the exposed part is blended
+void ImageView::drawOverlay(QPainter &inPainter, const QRect &inExposedRect)
+{
+  if (mOverlayData == nullptr || mOverlayData->check() == false)
+    return;
+  mOverlayData->startConversion();
+
+  RenderCache *cache = getRenderCache(mOverlayData, &mOverlayRenderCache);
+  cache->setVisibleRect(this, visibleRegion().boundingRect());
+  if (cache->update(*mOverlayData, this, inExposedRect, rect()))
+    cache->draw(inPainter, inExposedRect);
+}
+
+// -----------------------------------------------------------------------------
+// getZoomedSize
+// -----------------------------------------------------------------------------
+//  The size of the zoomed image before the view transform (see ImageScaler)
+QSize ImageView::getZoomedSize() const
+{
+  if (mImageData == nullptr)
+    return QSize();
+  return ImageScaler::getTargetSize(QSize((int )mImageData->getFormat().width(),
+                                          (int )mImageData->getFormat().height()), mZoomScale);
+}
+
+// -----------------------------------------------------------------------------
+// getRenderCache
+// -----------------------------------------------------------------------------
+//  (Re)acquires the cache of inImageData (mImageData or mOverlayData) when the
+//  zoom or the colormap was changed. The overlay is rendered with its own
+//  (transparent) color table
+RenderCache *ImageView::getRenderCache(ImageData *inImageData, std::shared_ptr<RenderCache> *ioCache)
+{
+  RenderCacheKey  key;
+  key.zoomScale = mZoomScale;
+  key.overlayFlag = (inImageData == mOverlayData);
+  if (key.overlayFlag)
+    key.colorMapIndex = ColorMap::CMI_NOT_SPECIFIED;
+  else
+    key.colorMapIndex = mColorMapIndex != ColorMap::CMI_ANY ? mColorMapIndex :
+                                                             mImageData->getColorMap();
+  key.interimFlag = mInterimRenderingFlag && mZoomScale < 1.0;  // Nearest anyway above 1
+  key.transform = mTransform;
+  if (*ioCache == nullptr || (*ioCache)->getKey() != key)
+  {
+    if (*ioCache != nullptr)
+      (*ioCache)->removeView(this);
+    *ioCache = inImageData->acquireRenderCache(key);
+  }
+  return ioCache->get();
+}
+
+// -----------------------------------------------------------------------------
+// releaseRenderCache
+// -----------------------------------------------------------------------------
+//  Releases the caches of both the image and the overlay
+void ImageView::releaseRenderCache()
+{
+  if (mRenderCache != nullptr)
+  {
+    mRenderCache->removeView(this);
+    mRenderCache.reset();
+  }
+  if (mOverlayRenderCache != nullptr)
+  {
+    mOverlayRenderCache->removeView(this);
+    mOverlayRenderCache.reset();
+  }
+}
@@ -22,6 +22,7 @@
 // Includes --------------------------------------------------------------------
 #include <QtWidgets>
 #include "ImageData.h"
+#include "RenderCache.h"
 
 // -----------------------------------------------------------------------------
 // ImageView class
@@ -33,26 +34,54 @@ Q_OBJECT
 public:
   // Constructors and Destructor -----------------------------------------------
   ImageView(QWidget *parent = nullptr, Qt::WindowFlags flags = Qt::WindowFlags());
+  virtual ~ImageView();
 
   // Member functions ----------------------------------------------------------
-  virtual void    updateWidget();
+  virtual void    updateWidget(const ImageData *inImageData, const QRect &inDirtyRect,
+                               uint64_t inFrameGeneration);
   virtual void    setImageSizeChangedFlag(bool inFlag);
+  virtual QRect   getVisibleImageRect() const;
 
   void setImageData(ImageData *inImageData);
+  ImageData *getImageData();
+  void setOverlayData(ImageData *inOverlayData);
+  ImageData *getOverlayData();
+  bool mapToImage(const QPoint &inPos, unsigned int *outX, unsigned int *outY) const;
+  QRect mapToImageRect(const QRect &inRect) const;
+  QRect mapFromImageRect(const QRect &inRect) const;
+  QPointF mapToImagePos(const QPointF &inPos) const;
+  QPointF mapFromImagePos(const QPointF &inPos) const;
+  uint64_t getFrameGeneration() const;
   double getZoomScale();
   void setZoomScale(double inScale);
   double calcZoomScale(int inStep);
+  void setColorMap(ColorMap::ColorMapIndex inIndex);
+  ColorMap::ColorMapIndex getColorMap() const;
+  void setInterimRendering(bool inFlag);
+  void setViewTransform(ImageScaler::Transform inTransform);
+  ImageScaler::Transform getViewTransform() const;
 
 protected:
   // Member functions ----------------------------------------------------------
   bool  updateSizeUsingImageData();
   void paintEvent(QPaintEvent *event) override;
+  RenderCache *getRenderCache(ImageData *inImageData, std::shared_ptr<RenderCache> *ioCache);
+  void releaseRenderCache();
+  void drawOverlay(QPainter &inPainter, const QRect &inExposedRect);
+  QSize getZoomedSize() const;
 
 private:
   // Member variables ----------------------------------------------------------
   ImageData *mImageData;
+  ImageData *mOverlayData;      // Drawn over mImageData (see ImageData::setOverlayColor())
   double    mZoomScale;
   bool mImageSizeChangedFlag;
+  bool mInterimRenderingFlag;   // Fast (nearest) rendering while the zoom is changing
+  uint64_t  mFrameGeneration;   // Of the frame shown (from updateWidget())
+  ImageScaler::Transform  mTransform;         // Flips / rotations (the data is not touched)
+  ColorMap::ColorMapIndex mColorMapIndex;     // CMI_ANY : the colormap of mImageData
+  std::shared_ptr<RenderCache>  mRenderCache; // Shared with the views of the same key
+  std::shared_ptr<RenderCache>  mOverlayRenderCache;  // Of mOverlayData
 };
 
 
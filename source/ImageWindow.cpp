@@ -32,13 +32,22 @@ ImageWindow::ImageWindow(QWidget *parent, Qt::WindowFlags flags)
   ImageType imageType(ImageType::PIXEL_TYPE_MONO, ImageType::BUFFER_TYPE_PIXEL_ALIGNED,
                       ImageType::DATA_TYPE_8BIT);
   ImageFormat format(imageType, 640, 480);
-  mImageData.allocate(format);
-  unsigned char *buf = (unsigned char *) mImageData.getData();
-
-  for (int y = 0; y < 480; y++)
-    for (int x = 0; x < 640; x++, buf++)
-      *buf = x ^ y;
-
-  mImageData.setImageModifiedFlag(true);
+  ImageData::PendingFramePtr frame = mImageData.beginFrame(format);
+  if (frame != nullptr)
+  {
+    unsigned char *buf = frame->buffer.get();
+    for (int y = 0; y < 480; y++)
+      for (int x = 0; x < 640; x++, buf++)
+        *buf = x ^ y;
+    mImageData.commitFrame(std::move(frame));
+  }
   mImageScrollArea.getImageView()->setImageData(&mImageData);
 }
+
+// -----------------------------------------------------------------------------
+// getImageScrollArea
+// -----------------------------------------------------------------------------
+ImageScrollArea *ImageWindow::getImageScrollArea()
+{
+  return &mImageScrollArea;
+}
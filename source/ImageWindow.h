@@ -35,6 +35,9 @@ public:
   // Constructors and Destructor -----------------------------------------------
   ImageWindow(QWidget *parent = nullptr, Qt::WindowFlags flags = Qt::WindowFlags());
 
+  // Member functions ----------------------------------------------------------
+  ImageScrollArea *getImageScrollArea();
+
 private:
   // Member variables ----------------------------------------------------------
   ImageScrollArea mImageScrollArea;
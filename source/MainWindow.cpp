@@ -36,6 +36,8 @@ MainWindow::MainWindow(QWidget *parent)
 void MainWindow::on_action_Open_triggered(void)
 {
   ImageWindow *child = new ImageWindow(this);
+  connect(child->getImageScrollArea(), &ImageScrollArea::pixelInfoChanged,
+          this, [this](const QString &inInfo) { mUI.statusbar->showMessage(inInfo); });
   mUI.mdiArea->addSubWindow(child);
   child->show();
 }
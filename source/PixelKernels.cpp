@@ -0,0 +1,1342 @@
+// =============================================================================
+//  PixelKernels.cpp
+//
+//  Written in 2022 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     PixelKernels.cpp
+  \author   Dairoku Sekiguchi
+  \version  1.0.0-pre_alpha.0
+  \date     2022/04/17
+*/
+
+// Includes --------------------------------------------------------------------
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "PixelKernels.h"
+
+// SIMD support ----------------------------------------------------------------
+//  The AVX2 kernels are compiled with a per function target attribute (GCC and
+//  clang) so the rest of the program does not require AVX2
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+  #define QIV_KERNELS_X86
+  #define QIV_TARGET_AVX2 __attribute__((target("avx2")))
+  #include <immintrin.h>
+#elif defined(_MSC_VER) && defined(_M_X64)
+  #define QIV_KERNELS_X86
+  #define QIV_TARGET_AVX2
+  #include <intrin.h>
+  #include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+  #define QIV_KERNELS_SSE2    // Baseline of x86-64, no runtime check needed
+  #include <emmintrin.h>
+#endif
+
+// Static Functions ------------------------------------------------------------
+static void applyLUT8Scalar(const uint8_t *inSrc, const uint32_t *inTable,
+                            uint32_t *outDst, size_t inNum);
+static void applyLUT16Scalar(const uint16_t *inSrc, const uint32_t *inTable, unsigned int inTableSize,
+                             uint32_t *outDst, size_t inNum, unsigned int inShift);
+static void applyLUT8To8Scalar(const uint8_t *inSrc, const uint8_t *inTable,
+                               uint8_t *outDst, size_t inNum);
+static void gather32Scalar(const uint32_t *inSrc, const int32_t *inIndex,
+                           uint32_t *outDst, size_t inNum);
+static void gatherLUT8Scalar(const uint8_t *inSrc, const int32_t *inIndex, const uint32_t *inTable,
+                             uint32_t *outDst, size_t inNum);
+static void accumulate8Scalar(const uint8_t *inSrc, uint32_t *ioSum, size_t inNum);
+static void boxReduceLUT8Scalar(const uint32_t *inSum, const int32_t *inStart, const int32_t *inEnd,
+                                const float *inScale, float inRowScale, const uint32_t *inTable,
+                                uint32_t *outDst, size_t inNum);
+static void windowWideTo8Scalar(const uint8_t *inSrc, unsigned int inBytesPerValue, bool inIsSigned,
+                                int64_t inLow, unsigned int inShift, uint8_t *outDst, size_t inNum);
+#ifdef QIV_KERNELS_X86
+static void applyLUT8AVX2(const uint8_t *inSrc, const uint32_t *inTable,
+                          uint32_t *outDst, size_t inNum);
+static void applyLUT16AVX2(const uint16_t *inSrc, const uint32_t *inTable, unsigned int inTableSize,
+                           uint32_t *outDst, size_t inNum, unsigned int inShift);
+static void applyLUT8To8AVX2(const uint8_t *inSrc, const uint8_t *inTable,
+                             uint8_t *outDst, size_t inNum);
+static void gather32AVX2(const uint32_t *inSrc, const int32_t *inIndex,
+                         uint32_t *outDst, size_t inNum);
+static void gatherLUT8AVX2(const uint8_t *inSrc, const int32_t *inIndex, const uint32_t *inTable,
+                           uint32_t *outDst, size_t inNum);
+static __m256i gatherBytesAVX2(const uint8_t *inBase, __m256i inIndex);
+static void accumulate8AVX2(const uint8_t *inSrc, uint32_t *ioSum, size_t inNum);
+static void boxReduceLUT8AVX2(const uint32_t *inSum, const int32_t *inStart, const int32_t *inEnd,
+                              const float *inScale, float inRowScale, const uint32_t *inTable,
+                              uint32_t *outDst, size_t inNum);
+static size_t expand4To8AVX2(const uint8_t *inSrc, bool inLsbFirst, const uint8_t *inTable,
+                             uint8_t *outDst, size_t inNum);
+static size_t windowWide24To8AVX2(const uint8_t *inSrc, bool inIsSigned, int64_t inLow,
+                                  unsigned int inShift, uint8_t *outDst, size_t inNum);
+static size_t windowWide48To8AVX2(const uint8_t *inSrc, bool inIsSigned, int64_t inLow,
+                                  unsigned int inShift, uint8_t *outDst, size_t inNum);
+#endif
+
+// Constants -------------------------------------------------------------------
+//  Tables up to this size (16KB as RGB32) stay in L1 and are applied with
+//  gathers. Larger tables (65536 entries = 256KB) miss the cache anyway and
+//  the unrolled scalar loop is as fast as gathers on most CPUs
+static const unsigned int kGatherTableSizeMax = 4096;
+
+// -----------------------------------------------------------------------------
+// packRGB32Table
+// -----------------------------------------------------------------------------
+//  inRgbTable is the R, G, B table made by ColorMap (inColorNum * 3 bytes)
+void PixelKernels::packRGB32Table(const unsigned char *inRgbTable, unsigned int inColorNum,
+                                  uint32_t *outTable)
+{
+  for (unsigned int i = 0; i < inColorNum; i++, inRgbTable += 3)
+    outTable[i] = 0xFF000000 |
+                  ((uint32_t )inRgbTable[0] << 16) |
+                  ((uint32_t )inRgbTable[1] << 8) |
+                  (uint32_t )inRgbTable[2];
+}
+
+// -----------------------------------------------------------------------------
+// applyLUT8
+// -----------------------------------------------------------------------------
+//  inTable must have 256 entries
+void PixelKernels::applyLUT8(const uint8_t *inSrc, const uint32_t *inTable,
+                             uint32_t *outDst, size_t inNum)
+{
+#ifdef QIV_KERNELS_X86
+  if (hasAVX2())
+  {
+    applyLUT8AVX2(inSrc, inTable, outDst, inNum);
+    return;
+  }
+#endif
+  applyLUT8Scalar(inSrc, inTable, outDst, inNum);
+}
+
+// -----------------------------------------------------------------------------
+// applyLUT8To8
+// -----------------------------------------------------------------------------
+//  8-bit to 8-bit (e.g. source value to display index). inTable must have 256
+//  entries. SSE2 has no byte lookup, the scalar loop is ~1 cycle / pixel
+void PixelKernels::applyLUT8To8(const uint8_t *inSrc, const uint8_t *inTable,
+                                uint8_t *outDst, size_t inNum)
+{
+#ifdef QIV_KERNELS_X86
+  if (hasAVX2())
+  {
+    applyLUT8To8AVX2(inSrc, inTable, outDst, inNum);
+    return;
+  }
+#endif
+  applyLUT8To8Scalar(inSrc, inTable, outDst, inNum);
+}
+
+// -----------------------------------------------------------------------------
+// applyLUT16
+// -----------------------------------------------------------------------------
+//  The index is the source value >> inShift (MSB aligned data), indexes larger
+//  than inTableSize - 1 (e.g. garbage in the unused upper bits of 12-bit data)
+//  are clamped to the last entry
+void PixelKernels::applyLUT16(const uint16_t *inSrc, const uint32_t *inTable, unsigned int inTableSize,
+                              uint32_t *outDst, size_t inNum, unsigned int inShift)
+{
+  if (inTableSize == 0)
+    return;
+#ifdef QIV_KERNELS_X86
+  if (inTableSize <= kGatherTableSizeMax && hasAVX2())
+  {
+    applyLUT16AVX2(inSrc, inTable, inTableSize, outDst, inNum, inShift);
+    return;
+  }
+#endif
+  applyLUT16Scalar(inSrc, inTable, inTableSize, outDst, inNum, inShift);
+}
+
+// -----------------------------------------------------------------------------
+// applyLUT16To8
+// -----------------------------------------------------------------------------
+//  The index is the source value >> inShift (MSB aligned data), indexes larger
+//  than inTableSize - 1 are clamped to the last entry
+void PixelKernels::applyLUT16To8(const uint16_t *inSrc, const uint8_t *inTable, unsigned int inTableSize,
+                                 uint8_t *outDst, size_t inNum, unsigned int inShift)
+{
+  if (inTableSize == 0)
+    return;
+  unsigned int  maxIndex = inTableSize - 1;
+  size_t  i = 0;
+  for (; i + 4 <= inNum; i += 4)
+  {
+    unsigned int  i0 = inSrc[i] >> inShift,     i1 = inSrc[i + 1] >> inShift;
+    unsigned int  i2 = inSrc[i + 2] >> inShift, i3 = inSrc[i + 3] >> inShift;
+    outDst[i]     = inTable[i0 < maxIndex ? i0 : maxIndex];
+    outDst[i + 1] = inTable[i1 < maxIndex ? i1 : maxIndex];
+    outDst[i + 2] = inTable[i2 < maxIndex ? i2 : maxIndex];
+    outDst[i + 3] = inTable[i3 < maxIndex ? i3 : maxIndex];
+  }
+  for (; i < inNum; i++)
+  {
+    unsigned int  index = inSrc[i] >> inShift;
+    outDst[i] = inTable[index < maxIndex ? index : maxIndex];
+  }
+}
+
+// -----------------------------------------------------------------------------
+// offsetSigned8
+// -----------------------------------------------------------------------------
+//  Signed 8-bit values to offset binary (value + 128, the sign bit flipped),
+//  so that -128 to 127 index a 256 entry table in order
+void PixelKernels::offsetSigned8(const uint8_t *inSrc, uint8_t *outDst, size_t inNum)
+{
+  size_t  i = 0;
+#ifdef QIV_KERNELS_SSE2
+  const __m128i signBit = _mm_set1_epi8(-128);
+  for (; i + 16 <= inNum; i += 16)
+    _mm_storeu_si128((__m128i *)(outDst + i),
+                     _mm_xor_si128(_mm_loadu_si128((const __m128i *)(inSrc + i)), signBit));
+#endif
+  for (; i < inNum; i++)
+    outDst[i] = inSrc[i] ^ 0x80;
+}
+
+// -----------------------------------------------------------------------------
+// offsetSigned16
+// -----------------------------------------------------------------------------
+//  Signed inBitWidth-bit values in 16-bit words to offset binary :
+//  ((value >> inShift) + 2^(inBitWidth - 1)) mod 2^inBitWidth. The bits above
+//  inBitWidth (sign extended or not) are ignored, inShift is the alignment
+//  shift of MSB aligned data. The result indexes a 2^inBitWidth entry table
+void PixelKernels::offsetSigned16(const uint16_t *inSrc, unsigned int inBitWidth, unsigned int inShift,
+                                  uint16_t *outDst, size_t inNum)
+{
+  if (inBitWidth == 0 || inBitWidth > 16)
+    return;
+  uint16_t  signBit = (uint16_t )(1 << (inBitWidth - 1));
+  uint16_t  mask = (uint16_t )((1 << inBitWidth) - 1);
+  size_t  i = 0;
+#ifdef QIV_KERNELS_SSE2
+  const __m128i shift = _mm_cvtsi32_si128((int )inShift);
+  const __m128i sign  = _mm_set1_epi16((short )signBit);
+  const __m128i bits  = _mm_set1_epi16((short )mask);
+  for (; i + 16 <= inNum; i += 16)
+  {
+    __m128i v0 = _mm_srl_epi16(_mm_loadu_si128((const __m128i *)(inSrc + i)), shift);
+    __m128i v1 = _mm_srl_epi16(_mm_loadu_si128((const __m128i *)(inSrc + i + 8)), shift);
+    _mm_storeu_si128((__m128i *)(outDst + i),     _mm_and_si128(_mm_xor_si128(v0, sign), bits));
+    _mm_storeu_si128((__m128i *)(outDst + i + 8), _mm_and_si128(_mm_xor_si128(v1, sign), bits));
+  }
+#endif
+  for (; i < inNum; i++)
+    outDst[i] = (uint16_t )(((inSrc[i] >> inShift) ^ signBit) & mask);
+}
+
+// -----------------------------------------------------------------------------
+// shiftNarrow16To8
+// -----------------------------------------------------------------------------
+//  min(source value >> inShift, 255), the linear full range display of N-bit
+//  data in 16-bit words without a table (inShift = N - 8, plus the alignment
+//  shift for MSB aligned data)
+void PixelKernels::shiftNarrow16To8(const uint16_t *inSrc, unsigned int inShift,
+                                    uint8_t *outDst, size_t inNum)
+{
+  size_t  i = 0;
+#ifdef QIV_KERNELS_SSE2
+  // packus saturates signed words, so clamp as unsigned first (no min_epu16 in SSE2)
+  const __m128i shift = _mm_cvtsi32_si128((int )inShift);
+  const __m128i max = _mm_set1_epi16(255);
+  for (; i + 16 <= inNum; i += 16)
+  {
+    __m128i v0 = _mm_srl_epi16(_mm_loadu_si128((const __m128i *)(inSrc + i)), shift);
+    __m128i v1 = _mm_srl_epi16(_mm_loadu_si128((const __m128i *)(inSrc + i + 8)), shift);
+    v0 = _mm_sub_epi16(v0, _mm_subs_epu16(v0, max));
+    v1 = _mm_sub_epi16(v1, _mm_subs_epu16(v1, max));
+    _mm_storeu_si128((__m128i *)(outDst + i), _mm_packus_epi16(v0, v1));
+  }
+#endif
+  for (; i < inNum; i++)
+  {
+    unsigned int  value = inSrc[i] >> inShift;
+    outDst[i] = (uint8_t )(value < 255 ? value : 255);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// expand1To8
+// -----------------------------------------------------------------------------
+//  1-bit pixels inX to inX + inNum - 1 of a packed row to inTable[0] / inTable[1]
+//  (a mask or a binary image straight to the 8-bit display indexes)
+void PixelKernels::expand1To8(const uint8_t *inRow, size_t inX, bool inLsbFirst, const uint8_t *inTable,
+                              uint8_t *outDst, size_t inNum)
+{
+  size_t  i = 0;
+  auto  scalar = [&](size_t inEnd)
+  {
+    for (; i < inEnd; i++)
+    {
+      size_t  x = inX + i;
+      unsigned int  shift = inLsbFirst ? (unsigned int )(x % 8) : 7 - (unsigned int )(x % 8);
+      outDst[i] = inTable[(inRow[x / 8] >> shift) & 1];
+    }
+  };
+  // Up to the next byte boundary first
+  scalar((8 - inX % 8) % 8 < inNum ? (8 - inX % 8) % 8 : inNum);
+#ifdef QIV_KERNELS_SSE2
+  // Each byte is broadcast to 8 lanes and tested against its bit mask
+  const __m128i bitMask = inLsbFirst ?
+          _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128) :
+          _mm_setr_epi8(-128, 64, 32, 16, 8, 4, 2, 1, -128, 64, 32, 16, 8, 4, 2, 1);
+  const __m128i value0 = _mm_set1_epi8((char )inTable[0]);
+  const __m128i diff = _mm_set1_epi8((char )(inTable[0] ^ inTable[1]));
+  for (; i + 16 <= inNum; i += 16)
+  {
+    const uint8_t *src = inRow + (inX + i) / 8;
+    __m128i v = _mm_cvtsi32_si128(src[0] | (src[1] << 8));
+    v = _mm_unpacklo_epi8(v, v);
+    v = _mm_unpacklo_epi16(v, v);
+    v = _mm_unpacklo_epi32(v, v);
+    __m128i set = _mm_cmpeq_epi8(_mm_and_si128(v, bitMask), bitMask);
+    _mm_storeu_si128((__m128i *)(outDst + i), _mm_xor_si128(value0, _mm_and_si128(set, diff)));
+  }
+#endif
+  scalar(inNum);
+}
+
+// -----------------------------------------------------------------------------
+// expand4To8
+// -----------------------------------------------------------------------------
+//  4-bit pixels to inTable[0] - inTable[15] (palette or label images).
+//  inLsbFirst : the first pixel is in the low nibble
+void PixelKernels::expand4To8(const uint8_t *inRow, size_t inX, bool inLsbFirst, const uint8_t *inTable,
+                              uint8_t *outDst, size_t inNum)
+{
+  size_t  i = 0;
+  auto  scalar = [&](size_t inEnd)
+  {
+    for (; i < inEnd; i++)
+    {
+      size_t  x = inX + i;
+      bool    low = ((x % 2) == 0) == inLsbFirst;
+      uint8_t byte = inRow[x / 2];
+      outDst[i] = inTable[low ? (byte & 0x0F) : (byte >> 4)];
+    }
+  };
+  scalar((inX % 2) != 0 && inNum > 0 ? 1 : 0);
+#ifdef QIV_KERNELS_X86
+  if (hasAVX2())
+    i += expand4To8AVX2(inRow + (inX + i) / 2, inLsbFirst, inTable, outDst + i, inNum - i);
+#endif
+  scalar(inNum);
+}
+
+// -----------------------------------------------------------------------------
+// windowWideTo8
+// -----------------------------------------------------------------------------
+//  clamp((value - inLow) >> inShift, 0, 255) for the little endian integers
+//  wider than 16 bits (inBytesPerValue = 3 to 7, e.g. 24-bit accumulators).
+//  The 8-bit window is [inLow, inLow + (256 << inShift)). inLow must be within
+//  +-2^62 and inShift less than 64. 24 and 48-bit values are widened with
+//  pshufb (AVX2), the others are read with one unaligned 8-byte load each
+void PixelKernels::windowWideTo8(const uint8_t *inSrc, unsigned int inBytesPerValue, bool inIsSigned,
+                                 int64_t inLow, unsigned int inShift, uint8_t *outDst, size_t inNum)
+{
+  if (inBytesPerValue < 3 || inBytesPerValue > 7 || inShift >= 64)
+    return;
+  size_t  i = 0;
+#ifdef QIV_KERNELS_X86
+  if (hasAVX2() && inBytesPerValue == 3)
+    i = windowWide24To8AVX2(inSrc, inIsSigned, inLow, inShift, outDst, inNum);
+  else if (hasAVX2() && inBytesPerValue == 6)
+    i = windowWide48To8AVX2(inSrc, inIsSigned, inLow, inShift, outDst, inNum);
+#endif
+  windowWideTo8Scalar(inSrc + i * inBytesPerValue, inBytesPerValue, inIsSigned, inLow, inShift,
+                      outDst + i, inNum - i);
+}
+
+// -----------------------------------------------------------------------------
+// packRGB32
+// -----------------------------------------------------------------------------
+//  Packs 8-bit color pixels (inPixelStep bytes each, R, G and B at the given
+//  byte offsets) to 0xFFRRGGBB
+void PixelKernels::packRGB32(const uint8_t *inSrc, unsigned int inPixelStep,
+                             unsigned int inR, unsigned int inG, unsigned int inB,
+                             uint32_t *outDst, size_t inNum)
+{
+  for (size_t i = 0; i < inNum; i++, inSrc += inPixelStep)
+    outDst[i] = 0xFF000000 |
+                ((uint32_t )inSrc[inR] << 16) |
+                ((uint32_t )inSrc[inG] << 8) |
+                (uint32_t )inSrc[inB];
+}
+
+// -----------------------------------------------------------------------------
+// gather32
+// -----------------------------------------------------------------------------
+//  outDst[i] = inSrc[inIndex[i]] (e.g. nearest neighbor resampling of a row)
+void PixelKernels::gather32(const uint32_t *inSrc, const int32_t *inIndex,
+                            uint32_t *outDst, size_t inNum)
+{
+#ifdef QIV_KERNELS_X86
+  if (hasAVX2())
+  {
+    gather32AVX2(inSrc, inIndex, outDst, inNum);
+    return;
+  }
+#endif
+  gather32Scalar(inSrc, inIndex, outDst, inNum);
+}
+
+// -----------------------------------------------------------------------------
+// transpose8
+// -----------------------------------------------------------------------------
+//  outDst[x][y] = inSrc[y][x] for an inWidth x inHeight block of 8-bit pixels
+//  (a 2D kernel, unlike the others). The strides are in bytes and may be
+//  negative (flipped). 8 x 8 tiles are transposed in registers with three
+//  rounds of unpacks, so every load and store is a full 8 bytes
+void PixelKernels::transpose8(const uint8_t *inSrc, ptrdiff_t inSrcLineStride,
+                              uint8_t *outDst, ptrdiff_t inDstLineStride, size_t inWidth, size_t inHeight)
+{
+  size_t  y = 0;
+#ifdef QIV_KERNELS_SSE2
+  for (; y + 8 <= inHeight; y += 8)
+  {
+    const uint8_t *src = inSrc + inSrcLineStride * (ptrdiff_t )y;
+    size_t  x = 0;
+    for (; x + 8 <= inWidth; x += 8)
+    {
+      __m128i r[8];
+      for (int i = 0; i < 8; i++)
+        r[i] = _mm_loadl_epi64((const __m128i *)(src + inSrcLineStride * i + x));
+      __m128i a0 = _mm_unpacklo_epi8(r[0], r[1]);
+      __m128i a1 = _mm_unpacklo_epi8(r[2], r[3]);
+      __m128i a2 = _mm_unpacklo_epi8(r[4], r[5]);
+      __m128i a3 = _mm_unpacklo_epi8(r[6], r[7]);
+      __m128i b0 = _mm_unpacklo_epi16(a0, a1);
+      __m128i b1 = _mm_unpackhi_epi16(a0, a1);
+      __m128i b2 = _mm_unpacklo_epi16(a2, a3);
+      __m128i b3 = _mm_unpackhi_epi16(a2, a3);
+      __m128i c[4] = {_mm_unpacklo_epi32(b0, b2), _mm_unpackhi_epi32(b0, b2),
+                      _mm_unpacklo_epi32(b1, b3), _mm_unpackhi_epi32(b1, b3)};
+      uint8_t *dst = outDst + inDstLineStride * (ptrdiff_t )x + y;
+      for (int i = 0; i < 4; i++)
+      {
+        _mm_storel_epi64((__m128i *)(dst + inDstLineStride * (2 * i)), c[i]);
+        _mm_storel_epi64((__m128i *)(dst + inDstLineStride * (2 * i + 1)),
+                         _mm_unpackhi_epi64(c[i], c[i]));
+      }
+    }
+    for (; x < inWidth; x++)
+      for (int i = 0; i < 8; i++)
+        outDst[inDstLineStride * (ptrdiff_t )x + y + i] = src[inSrcLineStride * i + x];
+  }
+#endif
+  for (; y < inHeight; y++)
+  {
+    const uint8_t *src = inSrc + inSrcLineStride * (ptrdiff_t )y;
+    for (size_t x = 0; x < inWidth; x++)
+      outDst[inDstLineStride * (ptrdiff_t )x + y] = src[x];
+  }
+}
+
+// -----------------------------------------------------------------------------
+// transpose32
+// -----------------------------------------------------------------------------
+//  The 32-bit pixel version of transpose8() (4 x 4 tiles)
+void PixelKernels::transpose32(const uint32_t *inSrc, ptrdiff_t inSrcLineStride,
+                               uint32_t *outDst, ptrdiff_t inDstLineStride, size_t inWidth, size_t inHeight)
+{
+  const uint8_t *srcBytes = (const uint8_t *)inSrc;
+  uint8_t *dstBytes = (uint8_t *)outDst;
+  size_t  y = 0;
+#ifdef QIV_KERNELS_SSE2
+  for (; y + 4 <= inHeight; y += 4)
+  {
+    const uint32_t  *src[4];
+    for (int i = 0; i < 4; i++)
+      src[i] = (const uint32_t *)(srcBytes + inSrcLineStride * (ptrdiff_t )(y + i));
+    size_t  x = 0;
+    for (; x + 4 <= inWidth; x += 4)
+    {
+      __m128i r0 = _mm_loadu_si128((const __m128i *)(src[0] + x));
+      __m128i r1 = _mm_loadu_si128((const __m128i *)(src[1] + x));
+      __m128i r2 = _mm_loadu_si128((const __m128i *)(src[2] + x));
+      __m128i r3 = _mm_loadu_si128((const __m128i *)(src[3] + x));
+      __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+      __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+      __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+      __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+      uint8_t *dst = dstBytes + inDstLineStride * (ptrdiff_t )x + y * 4;
+      _mm_storeu_si128((__m128i *)dst,                         _mm_unpacklo_epi64(t0, t1));
+      _mm_storeu_si128((__m128i *)(dst + inDstLineStride),     _mm_unpackhi_epi64(t0, t1));
+      _mm_storeu_si128((__m128i *)(dst + inDstLineStride * 2), _mm_unpacklo_epi64(t2, t3));
+      _mm_storeu_si128((__m128i *)(dst + inDstLineStride * 3), _mm_unpackhi_epi64(t2, t3));
+    }
+    for (; x < inWidth; x++)
+      for (int i = 0; i < 4; i++)
+        ((uint32_t *)(dstBytes + inDstLineStride * (ptrdiff_t )x))[y + i] = src[i][x];
+  }
+#endif
+  for (; y < inHeight; y++)
+  {
+    const uint32_t  *src = (const uint32_t *)(srcBytes + inSrcLineStride * (ptrdiff_t )y);
+    for (size_t x = 0; x < inWidth; x++)
+      ((uint32_t *)(dstBytes + inDstLineStride * (ptrdiff_t )x))[y] = src[x];
+  }
+}
+
+// -----------------------------------------------------------------------------
+// gatherLUT8
+// -----------------------------------------------------------------------------
+//  outDst[i] = inTable[inSrc[inIndex[i]]] (nearest neighbor resampling of an
+//  indexed row). inTable must have 256 entries
+void PixelKernels::gatherLUT8(const uint8_t *inSrc, const int32_t *inIndex, const uint32_t *inTable,
+                              uint32_t *outDst, size_t inNum)
+{
+#ifdef QIV_KERNELS_X86
+  // The AVX2 version only helps magnified rows (1.5x or more)
+  if (inNum >= 8 && std::abs((int64_t )inIndex[inNum - 1] - inIndex[0]) * 3 < (int64_t )inNum * 2 &&
+      hasAVX2())
+  {
+    gatherLUT8AVX2(inSrc, inIndex, inTable, outDst, inNum);
+    return;
+  }
+#endif
+  gatherLUT8Scalar(inSrc, inIndex, inTable, outDst, inNum);
+}
+
+// -----------------------------------------------------------------------------
+// gatherColumns32
+// -----------------------------------------------------------------------------
+//  gather32() from inLineNum lines at once, whose output pixels are side by
+//  side in the target lines (a transposed view : a source line is a target
+//  column). outDst + inDstLineStride * i gets inLines[c][inIndex[i]] for every
+//  line c. The loads are scattered, so there is no SIMD version
+void PixelKernels::gatherColumns32(const uint32_t *const *inLines, size_t inLineNum,
+                                   const int32_t *inIndex, uint32_t *outDst,
+                                   ptrdiff_t inDstLineStride, size_t inNum)
+{
+  uint8_t *dstBytes = (uint8_t *)outDst;
+  for (size_t i = 0; i < inNum; i++, dstBytes += inDstLineStride)
+  {
+    uint32_t  *dst = (uint32_t *)dstBytes;
+    int32_t   index = inIndex[i];
+    for (size_t c = 0; c < inLineNum; c++)
+      dst[c] = inLines[c][index];
+  }
+}
+
+// -----------------------------------------------------------------------------
+// gatherColumns8
+// -----------------------------------------------------------------------------
+//  gatherColumns32() for indexed pixels (the indexes are copied, the color
+//  table is applied to whole target lines afterwards)
+void PixelKernels::gatherColumns8(const uint8_t *const *inLines, size_t inLineNum,
+                                  const int32_t *inIndex, uint8_t *outDst,
+                                  ptrdiff_t inDstLineStride, size_t inNum)
+{
+  for (size_t i = 0; i < inNum; i++, outDst += inDstLineStride)
+  {
+    int32_t index = inIndex[i];
+    for (size_t c = 0; c < inLineNum; c++)
+      outDst[c] = inLines[c][index];
+  }
+}
+
+// -----------------------------------------------------------------------------
+// accumulate8
+// -----------------------------------------------------------------------------
+//  ioSum[i] += inSrc[i] (e.g. vertical pass of a box filter)
+void PixelKernels::accumulate8(const uint8_t *inSrc, uint32_t *ioSum, size_t inNum)
+{
+#ifdef QIV_KERNELS_X86
+  if (hasAVX2())
+  {
+    accumulate8AVX2(inSrc, ioSum, inNum);
+    return;
+  }
+#endif
+  accumulate8Scalar(inSrc, ioSum, inNum);
+}
+
+// -----------------------------------------------------------------------------
+// boxReduce32
+// -----------------------------------------------------------------------------
+//  Horizontal pass of a box filter for 4 component pixels. inSum holds the
+//  column sums (4 per source column) and output pixel i is the average of the
+//  columns [inStart[i], inEnd[i]) (relative to inSum), scaled by
+//  inScale[i] * inRowScale. Components are kept in memory order
+void PixelKernels::boxReduce32(const uint32_t *inSum, const int32_t *inStart, const int32_t *inEnd,
+                               const float *inScale, float inRowScale, uint8_t *outDst, size_t inNum)
+{
+#ifdef QIV_KERNELS_SSE2
+  const __m128 half = _mm_set1_ps(0.5f);
+  for (size_t i = 0; i < inNum; i++, outDst += 4)
+  {
+    const __m128i *s    = (const __m128i *)(inSum + (size_t )inStart[i] * 4);
+    const __m128i *sEnd = (const __m128i *)(inSum + (size_t )inEnd[i] * 4);
+    __m128i acc = _mm_setzero_si128();
+    for (; s < sEnd; s++)
+      acc = _mm_add_epi32(acc, _mm_loadu_si128(s));
+    __m128  v = _mm_mul_ps(_mm_cvtepi32_ps(acc), _mm_set1_ps(inScale[i] * inRowScale));
+    __m128i c = _mm_cvttps_epi32(_mm_add_ps(v, half));
+    c = _mm_packs_epi32(c, c);
+    c = _mm_packus_epi16(c, c);
+    int     packed = _mm_cvtsi128_si32(c);
+    memcpy(outDst, &packed, 4);
+  }
+#else
+  for (size_t i = 0; i < inNum; i++, outDst += 4)
+  {
+    uint32_t  c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+    const uint32_t  *s = inSum + (size_t )inStart[i] * 4;
+    const uint32_t  *sEnd = inSum + (size_t )inEnd[i] * 4;
+    for (; s < sEnd; s += 4)
+    {
+      c0 += s[0];
+      c1 += s[1];
+      c2 += s[2];
+      c3 += s[3];
+    }
+    float k = inScale[i] * inRowScale;
+    outDst[0] = (uint8_t )(c0 * k + 0.5f);
+    outDst[1] = (uint8_t )(c1 * k + 0.5f);
+    outDst[2] = (uint8_t )(c2 * k + 0.5f);
+    outDst[3] = (uint8_t )(c3 * k + 0.5f);
+  }
+#endif
+}
+
+// -----------------------------------------------------------------------------
+// boxReduceLUT8
+// -----------------------------------------------------------------------------
+//  Horizontal pass of a box filter for indexed pixels : the averaged index is
+//  looked up in inTable (256 entries)
+void PixelKernels::boxReduceLUT8(const uint32_t *inSum, const int32_t *inStart, const int32_t *inEnd,
+                                 const float *inScale, float inRowScale, const uint32_t *inTable,
+                                 uint32_t *outDst, size_t inNum)
+{
+#ifdef QIV_KERNELS_X86
+  if (hasAVX2())
+  {
+    boxReduceLUT8AVX2(inSum, inStart, inEnd, inScale, inRowScale, inTable, outDst, inNum);
+    return;
+  }
+#endif
+  boxReduceLUT8Scalar(inSum, inStart, inEnd, inScale, inRowScale, inTable, outDst, inNum);
+}
+
+// -----------------------------------------------------------------------------
+// boxReduceColumns32
+// -----------------------------------------------------------------------------
+//  boxReduce32() for up to BOX_REDUCE_COLUMN_NUM_32 target columns at once, whose output pixels are
+//  side by side in the target lines (a transposed view : a source line is a
+//  target column). The sums of column c start at inSum + inSumStride * c and
+//  output i (of every column) averages [inStart[i], inEnd[i]), scaled by
+//  inScale[i] * inColumnScale[c]. Its pixels go to outDst + inDstLineStride * i
+void PixelKernels::boxReduceColumns32(const uint32_t *inSum, size_t inSumStride, size_t inColumnNum,
+                                      const int32_t *inStart, const int32_t *inEnd,
+                                      const float *inScale, const float *inColumnScale,
+                                      uint8_t *outDst, ptrdiff_t inDstLineStride, size_t inNum)
+{
+#ifdef QIV_KERNELS_SSE2
+  // The missing columns read the first one (the result is not stored)
+  const uint32_t  *sum[4];
+  float   columnScale[4];
+  for (size_t c = 0; c < 4; c++)
+  {
+    size_t  col = c < inColumnNum ? c : 0;
+    sum[c] = inSum + inSumStride * col;
+    columnScale[c] = inColumnScale[col];
+  }
+  const __m128 half = _mm_set1_ps(0.5f);
+  for (size_t i = 0; i < inNum; i++, outDst += inDstLineStride)
+  {
+    __m128i acc0 = _mm_setzero_si128();
+    __m128i acc1 = _mm_setzero_si128();
+    __m128i acc2 = _mm_setzero_si128();
+    __m128i acc3 = _mm_setzero_si128();
+    for (size_t x = (size_t )inStart[i] * 4; x < (size_t )inEnd[i] * 4; x += 4)
+    {
+      acc0 = _mm_add_epi32(acc0, _mm_loadu_si128((const __m128i *)(sum[0] + x)));
+      acc1 = _mm_add_epi32(acc1, _mm_loadu_si128((const __m128i *)(sum[1] + x)));
+      acc2 = _mm_add_epi32(acc2, _mm_loadu_si128((const __m128i *)(sum[2] + x)));
+      acc3 = _mm_add_epi32(acc3, _mm_loadu_si128((const __m128i *)(sum[3] + x)));
+    }
+    float   rowScale = inScale[i];
+    __m128i v0 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(acc0),
+                                                        _mm_set1_ps(rowScale * columnScale[0])), half));
+    __m128i v1 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(acc1),
+                                                        _mm_set1_ps(rowScale * columnScale[1])), half));
+    __m128i v2 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(acc2),
+                                                        _mm_set1_ps(rowScale * columnScale[2])), half));
+    __m128i v3 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(acc3),
+                                                        _mm_set1_ps(rowScale * columnScale[3])), half));
+    __m128i packed = _mm_packus_epi16(_mm_packs_epi32(v0, v1), _mm_packs_epi32(v2, v3));
+    if (inColumnNum == 4)
+      _mm_storeu_si128((__m128i *)outDst, packed);
+    else
+    {
+      uint8_t buf[16];
+      _mm_storeu_si128((__m128i *)buf, packed);
+      memcpy(outDst, buf, inColumnNum * 4);
+    }
+  }
+#else
+  for (size_t i = 0; i < inNum; i++, outDst += inDstLineStride)
+    for (size_t c = 0; c < inColumnNum; c++)
+    {
+      const uint32_t  *s = inSum + inSumStride * c;
+      uint32_t  acc[4] = {0, 0, 0, 0};
+      for (size_t x = (size_t )inStart[i] * 4; x < (size_t )inEnd[i] * 4; x += 4)
+        for (int j = 0; j < 4; j++)
+          acc[j] += s[x + j];
+      float k = inScale[i] * inColumnScale[c];
+      for (int j = 0; j < 4; j++)
+        outDst[c * 4 + j] = (uint8_t )(acc[j] * k + 0.5f);
+    }
+#endif
+}
+
+// -----------------------------------------------------------------------------
+// boxReduceColumns8
+// -----------------------------------------------------------------------------
+//  boxReduceColumns32() for indexed pixels (up to BOX_REDUCE_COLUMN_NUM_8
+//  columns). The output is
+//  the averaged index (one byte per column), the color table is applied to
+//  whole target lines afterwards (applyLUT8()) instead of pixel by pixel
+void PixelKernels::boxReduceColumns8(const uint32_t *inSum, size_t inSumStride, size_t inColumnNum,
+                                     const int32_t *inStart, const int32_t *inEnd,
+                                     const float *inScale, const float *inColumnScale,
+                                     uint8_t *outDst, ptrdiff_t inDstLineStride, size_t inNum)
+{
+#ifdef QIV_KERNELS_SSE2
+  const uint32_t  *sum[8];
+  float   columnScale[8];
+  for (size_t c = 0; c < 8; c++)
+  {
+    size_t  col = c < inColumnNum ? c : 0;
+    sum[c] = inSum + inSumStride * col;
+    columnScale[c] = inColumnScale[col];
+  }
+  const __m128 scale0 = _mm_loadu_ps(columnScale);
+  const __m128 scale1 = _mm_loadu_ps(columnScale + 4);
+  const __m128 half = _mm_set1_ps(0.5f);
+  for (size_t i = 0; i < inNum; i++, outDst += inDstLineStride)
+  {
+    __m128i acc0 = _mm_setzero_si128();
+    __m128i acc1 = _mm_setzero_si128();
+    for (int32_t x = inStart[i]; x < inEnd[i]; x++)
+    {
+      acc0 = _mm_add_epi32(acc0, _mm_set_epi32((int )sum[3][x], (int )sum[2][x],
+                                               (int )sum[1][x], (int )sum[0][x]));
+      acc1 = _mm_add_epi32(acc1, _mm_set_epi32((int )sum[7][x], (int )sum[6][x],
+                                               (int )sum[5][x], (int )sum[4][x]));
+    }
+    __m128  rowScale = _mm_set1_ps(inScale[i]);
+    __m128i v0 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(acc0),
+                                                        _mm_mul_ps(scale0, rowScale)), half));
+    __m128i v1 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(acc1),
+                                                        _mm_mul_ps(scale1, rowScale)), half));
+    __m128i packed = _mm_packus_epi16(_mm_packs_epi32(v0, v1), _mm_setzero_si128());
+    if (inColumnNum == 8)
+      _mm_storel_epi64((__m128i *)outDst, packed);
+    else
+    {
+      uint8_t buf[16];
+      _mm_storeu_si128((__m128i *)buf, packed);
+      memcpy(outDst, buf, inColumnNum);
+    }
+  }
+#else
+  for (size_t i = 0; i < inNum; i++, outDst += inDstLineStride)
+    for (size_t c = 0; c < inColumnNum; c++)
+    {
+      const uint32_t  *s = inSum + inSumStride * c;
+      uint32_t  acc = 0;
+      for (int32_t x = inStart[i]; x < inEnd[i]; x++)
+        acc += s[x];
+      outDst[c] = (uint8_t )(acc * (inScale[i] * inColumnScale[c]) + 0.5f);
+    }
+#endif
+}
+
+// -----------------------------------------------------------------------------
+// hasAVX2
+// -----------------------------------------------------------------------------
+bool PixelKernels::hasAVX2()
+{
+#if defined(QIV_KERNELS_X86) && defined(_MSC_VER) && !defined(__clang__)
+  static const bool sHasAVX2 = []()
+  {
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+      return false;
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)  // OSXSAVE, AVX
+      return false;
+    if ((_xgetbv(0) & 0x06) != 0x06)  // XMM and YMM state enabled by the OS
+      return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+  }();
+  return sHasAVX2;
+#elif defined(QIV_KERNELS_X86)
+  static const bool sHasAVX2 = __builtin_cpu_supports("avx2");
+  return sHasAVX2;
+#else
+  return false;
+#endif
+}
+
+// -----------------------------------------------------------------------------
+// applyLUT8Scalar
+// -----------------------------------------------------------------------------
+static void applyLUT8Scalar(const uint8_t *inSrc, const uint32_t *inTable,
+                            uint32_t *outDst, size_t inNum)
+{
+  size_t  i = 0;
+  for (; i + 4 <= inNum; i += 4)
+  {
+    uint32_t  v0 = inTable[inSrc[i]];
+    uint32_t  v1 = inTable[inSrc[i + 1]];
+    uint32_t  v2 = inTable[inSrc[i + 2]];
+    uint32_t  v3 = inTable[inSrc[i + 3]];
+    outDst[i]     = v0;
+    outDst[i + 1] = v1;
+    outDst[i + 2] = v2;
+    outDst[i + 3] = v3;
+  }
+  for (; i < inNum; i++)
+    outDst[i] = inTable[inSrc[i]];
+}
+
+// -----------------------------------------------------------------------------
+// applyLUT16Scalar
+// -----------------------------------------------------------------------------
+static void applyLUT16Scalar(const uint16_t *inSrc, const uint32_t *inTable, unsigned int inTableSize,
+                             uint32_t *outDst, size_t inNum, unsigned int inShift)
+{
+  size_t  i = 0;
+  if (inShift == 0 && inTableSize >= 0x10000)   // No clamp needed
+  {
+    for (; i + 4 <= inNum; i += 4)
+    {
+      uint32_t  v0 = inTable[inSrc[i]];
+      uint32_t  v1 = inTable[inSrc[i + 1]];
+      uint32_t  v2 = inTable[inSrc[i + 2]];
+      uint32_t  v3 = inTable[inSrc[i + 3]];
+      outDst[i]     = v0;
+      outDst[i + 1] = v1;
+      outDst[i + 2] = v2;
+      outDst[i + 3] = v3;
+    }
+    for (; i < inNum; i++)
+      outDst[i] = inTable[inSrc[i]];
+    return;
+  }
+
+  unsigned int  maxIndex = inTableSize - 1;
+  for (; i + 4 <= inNum; i += 4)
+  {
+    unsigned int  i0 = inSrc[i] >> inShift,     i1 = inSrc[i + 1] >> inShift;
+    unsigned int  i2 = inSrc[i + 2] >> inShift, i3 = inSrc[i + 3] >> inShift;
+    outDst[i]     = inTable[i0 < maxIndex ? i0 : maxIndex];
+    outDst[i + 1] = inTable[i1 < maxIndex ? i1 : maxIndex];
+    outDst[i + 2] = inTable[i2 < maxIndex ? i2 : maxIndex];
+    outDst[i + 3] = inTable[i3 < maxIndex ? i3 : maxIndex];
+  }
+  for (; i < inNum; i++)
+  {
+    unsigned int  index = inSrc[i] >> inShift;
+    outDst[i] = inTable[index < maxIndex ? index : maxIndex];
+  }
+}
+
+// -----------------------------------------------------------------------------
+// applyLUT8To8Scalar
+// -----------------------------------------------------------------------------
+static void applyLUT8To8Scalar(const uint8_t *inSrc, const uint8_t *inTable,
+                               uint8_t *outDst, size_t inNum)
+{
+  size_t  i = 0;
+  for (; i + 4 <= inNum; i += 4)
+  {
+    uint8_t v0 = inTable[inSrc[i]];
+    uint8_t v1 = inTable[inSrc[i + 1]];
+    uint8_t v2 = inTable[inSrc[i + 2]];
+    uint8_t v3 = inTable[inSrc[i + 3]];
+    outDst[i]     = v0;
+    outDst[i + 1] = v1;
+    outDst[i + 2] = v2;
+    outDst[i + 3] = v3;
+  }
+  for (; i < inNum; i++)
+    outDst[i] = inTable[inSrc[i]];
+}
+
+// -----------------------------------------------------------------------------
+// gather32Scalar
+// -----------------------------------------------------------------------------
+static void gather32Scalar(const uint32_t *inSrc, const int32_t *inIndex,
+                           uint32_t *outDst, size_t inNum)
+{
+  size_t  i = 0;
+  for (; i + 4 <= inNum; i += 4)
+  {
+    uint32_t  v0 = inSrc[inIndex[i]];
+    uint32_t  v1 = inSrc[inIndex[i + 1]];
+    uint32_t  v2 = inSrc[inIndex[i + 2]];
+    uint32_t  v3 = inSrc[inIndex[i + 3]];
+    outDst[i]     = v0;
+    outDst[i + 1] = v1;
+    outDst[i + 2] = v2;
+    outDst[i + 3] = v3;
+  }
+  for (; i < inNum; i++)
+    outDst[i] = inSrc[inIndex[i]];
+}
+
+// -----------------------------------------------------------------------------
+// gatherLUT8Scalar
+// -----------------------------------------------------------------------------
+static void gatherLUT8Scalar(const uint8_t *inSrc, const int32_t *inIndex, const uint32_t *inTable,
+                             uint32_t *outDst, size_t inNum)
+{
+  size_t  i = 0;
+  for (; i + 4 <= inNum; i += 4)
+  {
+    uint32_t  v0 = inTable[inSrc[inIndex[i]]];
+    uint32_t  v1 = inTable[inSrc[inIndex[i + 1]]];
+    uint32_t  v2 = inTable[inSrc[inIndex[i + 2]]];
+    uint32_t  v3 = inTable[inSrc[inIndex[i + 3]]];
+    outDst[i]     = v0;
+    outDst[i + 1] = v1;
+    outDst[i + 2] = v2;
+    outDst[i + 3] = v3;
+  }
+  for (; i < inNum; i++)
+    outDst[i] = inTable[inSrc[inIndex[i]]];
+}
+
+// -----------------------------------------------------------------------------
+// accumulate8Scalar
+// -----------------------------------------------------------------------------
+static void accumulate8Scalar(const uint8_t *inSrc, uint32_t *ioSum, size_t inNum)
+{
+  for (size_t i = 0; i < inNum; i++)
+    ioSum[i] += inSrc[i];
+}
+
+// -----------------------------------------------------------------------------
+// boxReduceLUT8Scalar
+// -----------------------------------------------------------------------------
+//  The columns of a box are summed 4 at a time with SSE2 (wide boxes at low
+//  zoom), SSE2 has no gather to work on several target pixels at once
+static void boxReduceLUT8Scalar(const uint32_t *inSum, const int32_t *inStart, const int32_t *inEnd,
+                                const float *inScale, float inRowScale, const uint32_t *inTable,
+                                uint32_t *outDst, size_t inNum)
+{
+  for (size_t i = 0; i < inNum; i++)
+  {
+    int32_t   x = inStart[i];
+    uint32_t  acc = 0;
+#ifdef QIV_KERNELS_SSE2
+    if (x + 4 <= inEnd[i])
+    {
+      __m128i acc4 = _mm_setzero_si128();
+      for (; x + 4 <= inEnd[i]; x += 4)
+        acc4 = _mm_add_epi32(acc4, _mm_loadu_si128((const __m128i *)(inSum + x)));
+      acc4 = _mm_add_epi32(acc4, _mm_srli_si128(acc4, 8));
+      acc4 = _mm_add_epi32(acc4, _mm_srli_si128(acc4, 4));
+      acc = (uint32_t )_mm_cvtsi128_si32(acc4);
+    }
+#endif
+    for (; x < inEnd[i]; x++)
+      acc += inSum[x];
+    outDst[i] = inTable[(uint8_t )(acc * (inScale[i] * inRowScale) + 0.5f)];
+  }
+}
+
+// -----------------------------------------------------------------------------
+// windowWideTo8Scalar
+// -----------------------------------------------------------------------------
+//  x86 is little endian, so a value is one unaligned 8-byte load (masked)
+//  while 8 bytes are left in the row. The last values are read byte by byte
+static void windowWideTo8Scalar(const uint8_t *inSrc, unsigned int inBytesPerValue, bool inIsSigned,
+                                int64_t inLow, unsigned int inShift, uint8_t *outDst, size_t inNum)
+{
+  unsigned int  unusedBits = 64 - inBytesPerValue * 8;
+  size_t  i = 0;
+#ifdef QIV_KERNELS_X86
+  for (; i < inNum && (inNum - i) * inBytesPerValue >= 8; i++)
+  {
+    uint64_t  raw;
+    memcpy(&raw, inSrc + i * inBytesPerValue, 8);
+    raw <<= unusedBits;
+    int64_t value = inIsSigned ? (int64_t )raw >> unusedBits : (int64_t )(raw >> unusedBits);
+    int64_t index = (value - inLow) >> inShift;
+    outDst[i] = (uint8_t )(index < 0 ? 0 : (index > 255 ? 255 : index));
+  }
+#endif
+  for (; i < inNum; i++)
+  {
+    const uint8_t *src = inSrc + i * inBytesPerValue;
+    uint64_t  raw = 0;
+    for (unsigned int j = 0; j < inBytesPerValue; j++)
+      raw |= (uint64_t )src[j] << (j * 8);
+    raw <<= unusedBits;
+    int64_t value = inIsSigned ? (int64_t )raw >> unusedBits : (int64_t )(raw >> unusedBits);
+    int64_t index = (value - inLow) >> inShift;
+    outDst[i] = (uint8_t )(index < 0 ? 0 : (index > 255 ? 255 : index));
+  }
+}
+
+#ifdef QIV_KERNELS_X86
+// -----------------------------------------------------------------------------
+// applyLUT8AVX2
+// -----------------------------------------------------------------------------
+QIV_TARGET_AVX2
+static void applyLUT8AVX2(const uint8_t *inSrc, const uint32_t *inTable,
+                          uint32_t *outDst, size_t inNum)
+{
+  const int *table = (const int *)inTable;
+  size_t  i = 0;
+  for (; i + 16 <= inNum; i += 16)
+  {
+    __m128i src   = _mm_loadu_si128((const __m128i *)(inSrc + i));
+    __m256i index0 = _mm256_cvtepu8_epi32(src);
+    __m256i index1 = _mm256_cvtepu8_epi32(_mm_srli_si128(src, 8));
+    _mm256_storeu_si256((__m256i *)(outDst + i),     _mm256_i32gather_epi32(table, index0, 4));
+    _mm256_storeu_si256((__m256i *)(outDst + i + 8), _mm256_i32gather_epi32(table, index1, 4));
+  }
+  applyLUT8Scalar(inSrc + i, inTable, outDst + i, inNum - i);
+}
+
+// -----------------------------------------------------------------------------
+// applyLUT16AVX2
+// -----------------------------------------------------------------------------
+//  For the tables that stay in L1 (see kGatherTableSizeMax)
+QIV_TARGET_AVX2
+static void applyLUT16AVX2(const uint16_t *inSrc, const uint32_t *inTable, unsigned int inTableSize,
+                           uint32_t *outDst, size_t inNum, unsigned int inShift)
+{
+  const int *table = (const int *)inTable;
+  __m256i maxIndex = _mm256_set1_epi32((int )(inTableSize - 1));
+  __m128i shift = _mm_cvtsi32_si128((int )inShift);
+  size_t  i = 0;
+  for (; i + 16 <= inNum; i += 16)
+  {
+    __m256i src   = _mm256_srl_epi16(_mm256_loadu_si256((const __m256i *)(inSrc + i)), shift);
+    __m256i index0 = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(src));
+    __m256i index1 = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(src, 1));
+    index0 = _mm256_min_epu32(index0, maxIndex);
+    index1 = _mm256_min_epu32(index1, maxIndex);
+    _mm256_storeu_si256((__m256i *)(outDst + i),     _mm256_i32gather_epi32(table, index0, 4));
+    _mm256_storeu_si256((__m256i *)(outDst + i + 8), _mm256_i32gather_epi32(table, index1, 4));
+  }
+  _mm256_zeroupper();   // The scalar function is SSE code
+  applyLUT16Scalar(inSrc + i, inTable, inTableSize, outDst + i, inNum - i, inShift);
+}
+
+// -----------------------------------------------------------------------------
+// applyLUT8To8AVX2
+// -----------------------------------------------------------------------------
+//  The entries are gathered 8 at a time and packed back to bytes
+QIV_TARGET_AVX2
+static void applyLUT8To8AVX2(const uint8_t *inSrc, const uint8_t *inTable,
+                             uint8_t *outDst, size_t inNum)
+{
+  const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+  size_t  i = 0;
+  for (; i + 32 <= inNum; i += 32)
+  {
+    __m128i src0 = _mm_loadu_si128((const __m128i *)(inSrc + i));
+    __m128i src1 = _mm_loadu_si128((const __m128i *)(inSrc + i + 16));
+    __m256i v0 = gatherBytesAVX2(inTable, _mm256_cvtepu8_epi32(src0));
+    __m256i v1 = gatherBytesAVX2(inTable, _mm256_cvtepu8_epi32(_mm_srli_si128(src0, 8)));
+    __m256i v2 = gatherBytesAVX2(inTable, _mm256_cvtepu8_epi32(src1));
+    __m256i v3 = gatherBytesAVX2(inTable, _mm256_cvtepu8_epi32(_mm_srli_si128(src1, 8)));
+    __m256i v = _mm256_packus_epi16(_mm256_packus_epi32(v0, v1), _mm256_packus_epi32(v2, v3));
+    v = _mm256_permutevar8x32_epi32(v, order);
+    _mm256_storeu_si256((__m256i *)(outDst + i), v);
+  }
+  _mm256_zeroupper();   // The scalar function is SSE code
+  applyLUT8To8Scalar(inSrc + i, inTable, outDst + i, inNum - i);
+}
+
+// -----------------------------------------------------------------------------
+// gather32AVX2
+// -----------------------------------------------------------------------------
+QIV_TARGET_AVX2
+static void gather32AVX2(const uint32_t *inSrc, const int32_t *inIndex,
+                         uint32_t *outDst, size_t inNum)
+{
+  const int *src = (const int *)inSrc;
+  size_t  i = 0;
+  for (; i + 16 <= inNum; i += 16)
+  {
+    __m256i index0 = _mm256_loadu_si256((const __m256i *)(inIndex + i));
+    __m256i index1 = _mm256_loadu_si256((const __m256i *)(inIndex + i + 8));
+    _mm256_storeu_si256((__m256i *)(outDst + i),     _mm256_i32gather_epi32(src, index0, 4));
+    _mm256_storeu_si256((__m256i *)(outDst + i + 8), _mm256_i32gather_epi32(src, index1, 4));
+  }
+  gather32Scalar(inSrc, inIndex + i, outDst + i, inNum - i);
+}
+
+// -----------------------------------------------------------------------------
+// gatherLUT8AVX2
+// -----------------------------------------------------------------------------
+//  When magnified (1.5x or more), the source span of a chunk is looked up once and
+//  each 8 target pixels that come from 8 consecutive source pixels are picked
+//  with one permute. Gathers are avoided, two of them (index and color) per 8
+//  pixels are slower than the scalar loop on many CPUs
+QIV_TARGET_AVX2
+static void gatherLUT8AVX2(const uint8_t *inSrc, const int32_t *inIndex, const uint32_t *inTable,
+                           uint32_t *outDst, size_t inNum)
+{
+  const size_t  kChunkSize = 256;
+  const int32_t kSpanMax = kChunkSize * 3 / 4;   // Above the 1.5x of gatherLUT8()
+  alignas(32) uint32_t  colors[kSpanMax + 8];
+
+  for (size_t i = 0; i < inNum; i += kChunkSize)
+  {
+    size_t  num = std::min(kChunkSize, inNum - i);
+    const int32_t *index = inIndex + i;
+    uint32_t  *dst = outDst + i;
+
+    // The span is taken from the end points (the index is monotonic when
+    // resampling) and each 8 pixels are checked against it
+    int32_t x0 = std::min(index[0], index[num - 1]);
+    int32_t span = std::max(index[0], index[num - 1]) - x0;
+
+    // The loops are not calls to the scalar functions : those are SSE code and
+    // the compiler keeps the upper halves live across calls to local functions
+    // (AVX to SSE transition on every instruction)
+    if (num < 8 || span >= kSpanMax)
+    {
+      for (size_t j = 0; j < num; j++)
+        dst[j] = inTable[inSrc[index[j]]];
+      continue;
+    }
+    for (int32_t x = 0; x <= span; x++)
+      colors[x] = inTable[inSrc[x0 + x]];
+
+    const __m256i seven = _mm256_set1_epi32(7);
+    const __m256i span8 = _mm256_set1_epi32(span);
+    size_t  j = 0;
+    for (; j + 8 <= num; j += 8)
+    {
+      __m256i v = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(index + j)),
+                                   _mm256_set1_epi32(x0));
+      int32_t base = std::min(index[j], index[j + 7]) - x0;
+      __m256i rel  = _mm256_sub_epi32(v, _mm256_set1_epi32(base));
+      __m256i isIn = _mm256_and_si256(
+                       _mm256_cmpeq_epi32(_mm256_max_epu32(rel, seven), seven),
+                       _mm256_cmpeq_epi32(_mm256_max_epu32(v, span8), span8));
+      if (_mm256_movemask_epi8(isIn) == -1)
+      {
+        __m256i c = _mm256_loadu_si256((const __m256i *)(colors + base));
+        _mm256_storeu_si256((__m256i *)(dst + j), _mm256_permutevar8x32_epi32(c, rel));
+      }
+      else
+      {
+        for (size_t k = j; k < j + 8; k++)
+          dst[k] = inTable[inSrc[index[k]]];
+      }
+    }
+    for (; j < num; j++)
+      dst[j] = inTable[inSrc[index[j]]];
+  }
+}
+
+// -----------------------------------------------------------------------------
+// gatherBytesAVX2
+// -----------------------------------------------------------------------------
+//  inBase[inIndex[i]] as 32-bit values. The bytes are gathered as the aligned
+//  32-bit words that hold them and shifted down. Such a word may start up to
+//  3 bytes before inBase and end up to 3 bytes after the last byte, but it
+//  never crosses a page, so it can't fault. ASan / valgrind may report it
+//  all the same (the extra bytes are never used)
+QIV_TARGET_AVX2
+static inline __m256i gatherBytesAVX2(const uint8_t *inBase, __m256i inIndex)
+{
+  size_t  misalign = (uintptr_t )inBase & 3;
+  __m256i index = _mm256_add_epi32(inIndex, _mm256_set1_epi32((int )misalign));
+  __m256i word  = _mm256_i32gather_epi32((const int *)(inBase - misalign),
+                                         _mm256_srli_epi32(index, 2), 4);
+  __m256i shift = _mm256_slli_epi32(_mm256_and_si256(index, _mm256_set1_epi32(3)), 3);
+  return _mm256_and_si256(_mm256_srlv_epi32(word, shift), _mm256_set1_epi32(0xFF));
+}
+
+// -----------------------------------------------------------------------------
+// accumulate8AVX2
+// -----------------------------------------------------------------------------
+QIV_TARGET_AVX2
+static void accumulate8AVX2(const uint8_t *inSrc, uint32_t *ioSum, size_t inNum)
+{
+  size_t  i = 0;
+  for (; i + 16 <= inNum; i += 16)
+  {
+    __m128i src  = _mm_loadu_si128((const __m128i *)(inSrc + i));
+    __m256i sum0 = _mm256_loadu_si256((const __m256i *)(ioSum + i));
+    __m256i sum1 = _mm256_loadu_si256((const __m256i *)(ioSum + i + 8));
+    sum0 = _mm256_add_epi32(sum0, _mm256_cvtepu8_epi32(src));
+    sum1 = _mm256_add_epi32(sum1, _mm256_cvtepu8_epi32(_mm_srli_si128(src, 8)));
+    _mm256_storeu_si256((__m256i *)(ioSum + i),     sum0);
+    _mm256_storeu_si256((__m256i *)(ioSum + i + 8), sum1);
+  }
+  accumulate8Scalar(inSrc + i, ioSum + i, inNum - i);
+}
+
+// -----------------------------------------------------------------------------
+// boxReduceLUT8AVX2
+// -----------------------------------------------------------------------------
+//  8 target pixels at a time : their boxes are summed side by side (one masked
+//  gather per column, a pixel drops out once its box is done)
+QIV_TARGET_AVX2
+static void boxReduceLUT8AVX2(const uint32_t *inSum, const int32_t *inStart, const int32_t *inEnd,
+                              const float *inScale, float inRowScale, const uint32_t *inTable,
+                              uint32_t *outDst, size_t inNum)
+{
+  const int *sum   = (const int *)inSum;
+  const int *table = (const int *)inTable;
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i one  = _mm256_set1_epi32(1);
+  const __m256  half = _mm256_set1_ps(0.5f);
+  size_t  i = 0;
+  for (; i + 8 <= inNum; i += 8)
+  {
+    __m256i column = _mm256_loadu_si256((const __m256i *)(inStart + i));
+    __m256i width  = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(inEnd + i)), column);
+    __m256i acc    = zero;
+    __m256i mask   = _mm256_cmpgt_epi32(width, zero);
+    while (_mm256_movemask_epi8(mask) != 0)
+    {
+      acc    = _mm256_add_epi32(acc, _mm256_mask_i32gather_epi32(zero, sum, column, mask, 4));
+      column = _mm256_add_epi32(column, one);
+      width  = _mm256_sub_epi32(width, one);
+      mask   = _mm256_cmpgt_epi32(width, zero);
+    }
+    __m256  k = _mm256_mul_ps(_mm256_loadu_ps(inScale + i), _mm256_set1_ps(inRowScale));
+    __m256i index = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(acc), k), half));
+    index = _mm256_min_epu32(index, _mm256_set1_epi32(0xFF));
+    _mm256_storeu_si256((__m256i *)(outDst + i), _mm256_i32gather_epi32(table, index, 4));
+  }
+  _mm256_zeroupper();   // The scalar function is SSE code
+  boxReduceLUT8Scalar(inSum, inStart + i, inEnd + i, inScale + i, inRowScale, inTable,
+                      outDst + i, inNum - i);
+}
+
+// -----------------------------------------------------------------------------
+// expand4To8AVX2
+// -----------------------------------------------------------------------------
+//  The nibbles are split and interleaved, then looked up with pshufb (the 16
+//  entry table fits in one register). Returns the number of pixels done
+QIV_TARGET_AVX2
+static size_t expand4To8AVX2(const uint8_t *inSrc, bool inLsbFirst, const uint8_t *inTable,
+                             uint8_t *outDst, size_t inNum)
+{
+  const __m128i table = _mm_loadu_si128((const __m128i *)inTable);
+  const __m128i lowMask = _mm_set1_epi8(0x0F);
+  size_t  i = 0;
+  for (; i + 32 <= inNum; i += 32)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i *)(inSrc + i / 2));
+    __m128i low  = _mm_and_si128(v, lowMask);
+    __m128i high = _mm_and_si128(_mm_srli_epi16(v, 4), lowMask);
+    __m128i first  = inLsbFirst ? low : high;
+    __m128i second = inLsbFirst ? high : low;
+    __m128i p0 = _mm_unpacklo_epi8(first, second);
+    __m128i p1 = _mm_unpackhi_epi8(first, second);
+    _mm_storeu_si128((__m128i *)(outDst + i), _mm_shuffle_epi8(table, p0));
+    _mm_storeu_si128((__m128i *)(outDst + i + 16), _mm_shuffle_epi8(table, p1));
+  }
+  return i;
+}
+
+// -----------------------------------------------------------------------------
+// windowWide24To8AVX2
+// -----------------------------------------------------------------------------
+//  8 values per 24 bytes : the dwords are spread so that each 128-bit lane
+//  holds 12 bytes, then pshufb puts each value in the top 3 bytes of a dword
+//  and a 8-bit shift (arithmetic for the signed values) extends it. The
+//  difference fits in 32 bits, packs / packus do the clamping
+QIV_TARGET_AVX2
+static size_t windowWide24To8AVX2(const uint8_t *inSrc, bool inIsSigned, int64_t inLow,
+                                  unsigned int inShift, uint8_t *outDst, size_t inNum)
+{
+  if (inLow < -(INT64_C(1) << 30) || inLow > (INT64_C(1) << 30))
+    return 0;
+  const __m256i spread = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+  const __m256i widen = _mm256_setr_epi8(
+          -128, 0, 1, 2, -128, 3, 4, 5, -128, 6, 7, 8, -128, 9, 10, 11,
+          -128, 0, 1, 2, -128, 3, 4, 5, -128, 6, 7, 8, -128, 9, 10, 11);
+  const __m256i low = _mm256_set1_epi32((int32_t )inLow);
+  const __m128i shift = _mm_cvtsi32_si128((int )(inShift < 31 ? inShift : 31));
+  size_t  i = 0;
+  // The 32-byte load reads 8 bytes past the 8 values
+  for (; i + 11 <= inNum; i += 8)
+  {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(inSrc + i * 3));
+    v = _mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(v, spread), widen);
+    v = inIsSigned ? _mm256_srai_epi32(v, 8) : _mm256_srli_epi32(v, 8);
+    v = _mm256_sra_epi32(_mm256_sub_epi32(v, low), shift);
+    v = _mm256_packus_epi16(_mm256_packs_epi32(v, v), v);
+    uint32_t  lo = (uint32_t )_mm_cvtsi128_si32(_mm256_castsi256_si128(v));
+    uint32_t  hi = (uint32_t )_mm_cvtsi128_si32(_mm256_extracti128_si256(v, 1));
+    memcpy(outDst + i, &lo, 4);
+    memcpy(outDst + i + 4, &hi, 4);
+  }
+  return i;
+}
+
+// -----------------------------------------------------------------------------
+// windowWide48To8AVX2
+// -----------------------------------------------------------------------------
+//  4 values per 24 bytes, zero extended to qwords by pshufb. The signed values
+//  are biased by 2^47 (sign bit flipped) together with inLow, so the 64-bit
+//  difference is exact. There is no 64-bit arithmetic shift in AVX2 : it is
+//  a logical one with the sign bit extended by xor / sub
+QIV_TARGET_AVX2
+static size_t windowWide48To8AVX2(const uint8_t *inSrc, bool inIsSigned, int64_t inLow,
+                                  unsigned int inShift, uint8_t *outDst, size_t inNum)
+{
+  const __m256i spread = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+  const __m256i widen = _mm256_setr_epi8(
+          0, 1, 2, 3, 4, 5, -128, -128, 6, 7, 8, 9, 10, 11, -128, -128,
+          0, 1, 2, 3, 4, 5, -128, -128, 6, 7, 8, 9, 10, 11, -128, -128);
+  const __m256i narrow = _mm256_setr_epi8(
+          0, 8, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128,
+          0, 8, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128, -128);
+  const int64_t bias = inIsSigned ? (INT64_C(1) << 47) : 0;
+  const __m256i signFlip = _mm256_set1_epi64x(bias);
+  const __m256i low = _mm256_set1_epi64x(inLow + bias);
+  const __m256i signBit = _mm256_set1_epi64x((int64_t )(UINT64_C(1) << (63 - inShift)));
+  const __m256i max = _mm256_set1_epi64x(255);
+  const __m128i shift = _mm_cvtsi32_si128((int )inShift);
+  size_t  i = 0;
+  // The 32-byte load reads 8 bytes past the 4 values
+  for (; i + 6 <= inNum; i += 4)
+  {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(inSrc + i * 6));
+    v = _mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(v, spread), widen);
+    v = _mm256_sub_epi64(_mm256_xor_si256(v, signFlip), low);
+    v = _mm256_srl_epi64(v, shift);
+    v = _mm256_sub_epi64(_mm256_xor_si256(v, signBit), signBit);
+    // Negative -> 0, larger than 255 -> all ones (0xFF in the low byte)
+    v = _mm256_andnot_si256(_mm256_cmpgt_epi64(_mm256_setzero_si256(), v), v);
+    v = _mm256_or_si256(v, _mm256_cmpgt_epi64(v, max));
+    v = _mm256_shuffle_epi8(v, narrow);
+    uint16_t  lo = (uint16_t )_mm_cvtsi128_si32(_mm256_castsi256_si128(v));
+    uint16_t  hi = (uint16_t )_mm_cvtsi128_si32(_mm256_extracti128_si256(v, 1));
+    memcpy(outDst + i, &lo, 2);
+    memcpy(outDst + i + 2, &hi, 2);
+  }
+  return i;
+}
+#endif
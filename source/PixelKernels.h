@@ -0,0 +1,96 @@
+// =============================================================================
+//  PixelKernels.h
+//
+//  Written in 2022 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     PixelKernels.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0-pre_alpha.0
+  \date     2022/04/17
+*/
+#ifndef QIV_PIXEL_KERNELS_H
+#define QIV_PIXEL_KERNELS_H
+
+// Includes --------------------------------------------------------------------
+#include <cstddef>
+#include <cstdint>
+
+// -----------------------------------------------------------------------------
+// PixelKernels class
+// -----------------------------------------------------------------------------
+//  Row kernels for the display conversion. All the functions work on one
+//  contiguous run of pixels and select the SIMD version (if any) at runtime.
+//  The output is 0xFFRRGGBB (QImage::Format_RGB32, which is also a valid
+//  Format_ARGB32_Premultiplied pixel since alpha is always 0xFF)
+class PixelKernels
+{
+public:
+  // Constants -----------------------------------------------------------------
+  const static size_t BOX_REDUCE_COLUMN_NUM_32 = 4;   // Columns per boxReduceColumns32()
+  const static size_t BOX_REDUCE_COLUMN_NUM_8  = 8;   // Columns per boxReduceColumns8()
+
+  // Static Functions ----------------------------------------------------------
+  static void packRGB32Table(const unsigned char *inRgbTable, unsigned int inColorNum,
+                             uint32_t *outTable);
+  static void applyLUT8(const uint8_t *inSrc, const uint32_t *inTable,
+                        uint32_t *outDst, size_t inNum);
+  static void applyLUT8To8(const uint8_t *inSrc, const uint8_t *inTable,
+                           uint8_t *outDst, size_t inNum);
+  static void applyLUT16(const uint16_t *inSrc, const uint32_t *inTable, unsigned int inTableSize,
+                         uint32_t *outDst, size_t inNum, unsigned int inShift = 0);
+  static void applyLUT16To8(const uint16_t *inSrc, const uint8_t *inTable, unsigned int inTableSize,
+                            uint8_t *outDst, size_t inNum, unsigned int inShift = 0);
+  static void offsetSigned8(const uint8_t *inSrc, uint8_t *outDst, size_t inNum);
+  static void offsetSigned16(const uint16_t *inSrc, unsigned int inBitWidth, unsigned int inShift,
+                             uint16_t *outDst, size_t inNum);
+  static void shiftNarrow16To8(const uint16_t *inSrc, unsigned int inShift,
+                               uint8_t *outDst, size_t inNum);
+  static void expand1To8(const uint8_t *inRow, size_t inX, bool inLsbFirst, const uint8_t *inTable,
+                         uint8_t *outDst, size_t inNum);
+  static void expand4To8(const uint8_t *inRow, size_t inX, bool inLsbFirst, const uint8_t *inTable,
+                         uint8_t *outDst, size_t inNum);
+  static void windowWideTo8(const uint8_t *inSrc, unsigned int inBytesPerValue, bool inIsSigned,
+                            int64_t inLow, unsigned int inShift, uint8_t *outDst, size_t inNum);
+  static void packRGB32(const uint8_t *inSrc, unsigned int inPixelStep,
+                        unsigned int inR, unsigned int inG, unsigned int inB,
+                        uint32_t *outDst, size_t inNum);
+  static void gather32(const uint32_t *inSrc, const int32_t *inIndex,
+                       uint32_t *outDst, size_t inNum);
+  static void transpose8(const uint8_t *inSrc, ptrdiff_t inSrcLineStride,
+                         uint8_t *outDst, ptrdiff_t inDstLineStride, size_t inWidth, size_t inHeight);
+  static void transpose32(const uint32_t *inSrc, ptrdiff_t inSrcLineStride,
+                          uint32_t *outDst, ptrdiff_t inDstLineStride, size_t inWidth, size_t inHeight);
+  static void gatherLUT8(const uint8_t *inSrc, const int32_t *inIndex, const uint32_t *inTable,
+                         uint32_t *outDst, size_t inNum);
+  static void gatherColumns32(const uint32_t *const *inLines, size_t inLineNum,
+                              const int32_t *inIndex, uint32_t *outDst,
+                              ptrdiff_t inDstLineStride, size_t inNum);
+  static void gatherColumns8(const uint8_t *const *inLines, size_t inLineNum,
+                             const int32_t *inIndex, uint8_t *outDst,
+                             ptrdiff_t inDstLineStride, size_t inNum);
+  static void accumulate8(const uint8_t *inSrc, uint32_t *ioSum, size_t inNum);
+  static void boxReduce32(const uint32_t *inSum, const int32_t *inStart, const int32_t *inEnd,
+                          const float *inScale, float inRowScale, uint8_t *outDst, size_t inNum);
+  static void boxReduceLUT8(const uint32_t *inSum, const int32_t *inStart, const int32_t *inEnd,
+                            const float *inScale, float inRowScale, const uint32_t *inTable,
+                            uint32_t *outDst, size_t inNum);
+  static void boxReduceColumns32(const uint32_t *inSum, size_t inSumStride, size_t inColumnNum,
+                                 const int32_t *inStart, const int32_t *inEnd,
+                                 const float *inScale, const float *inColumnScale,
+                                 uint8_t *outDst, ptrdiff_t inDstLineStride, size_t inNum);
+  static void boxReduceColumns8(const uint32_t *inSum, size_t inSumStride, size_t inColumnNum,
+                                const int32_t *inStart, const int32_t *inEnd,
+                                const float *inScale, const float *inColumnScale,
+                                uint8_t *outDst, ptrdiff_t inDstLineStride, size_t inNum);
+  static bool hasAVX2();
+};
+
+#endif //QIV_PIXEL_KERNELS_H
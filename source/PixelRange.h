@@ -0,0 +1,186 @@
+// =============================================================================
+//  PixelRange.h
+//
+//  Written in 2022 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     PixelRange.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0-pre_alpha.0
+  \date     2022/04/10
+*/
+#ifndef QIV_PIXEL_RANGE_H
+#define QIV_PIXEL_RANGE_H
+
+// Includes --------------------------------------------------------------------
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+#include "ImageFormat.h"
+
+// -----------------------------------------------------------------------------
+// PixelRowSpan class
+// -----------------------------------------------------------------------------
+//  A typed view of one row : width() pixels of N contiguous components of T.
+//  T can be const qualified for read-only access.
+template <typename T, unsigned int N = 1>
+class PixelRowSpan
+{
+public:
+  // Constructors and Destructor -----------------------------------------------
+  PixelRowSpan(T *inPtr, unsigned int inWidth) :
+    mPtr(inPtr), mWidth(inWidth)
+  {
+  }
+
+  // Member functions ----------------------------------------------------------
+  T *data() const { return mPtr; }
+  unsigned int width() const { return mWidth; }
+  T *pixel(unsigned int inX) const
+  {
+    assert(inX < mWidth);
+    return mPtr + (size_t )inX * N;
+  }
+  T &operator()(unsigned int inX, unsigned int inChannel = 0) const
+  {
+    assert(inX < mWidth && inChannel < N);
+    return mPtr[(size_t )inX * N + inChannel];
+  }
+  // Component-wise iteration (N * width() elements)
+  T *begin() const { return mPtr; }
+  T *end() const { return mPtr + (size_t )mWidth * N; }
+
+private:
+  // Member variables ----------------------------------------------------------
+  T             *mPtr;
+  unsigned int  mWidth;
+};
+
+// -----------------------------------------------------------------------------
+// PixelRange class
+// -----------------------------------------------------------------------------
+//  A typed 2D strided view of an image buffer. Pixels in a row are contiguous
+//  (N components of T each), rows are separated by a byte stride that can be
+//  larger than the row itself or negative.
+template <typename T, unsigned int N = 1>
+class PixelRange
+{
+public:
+  // Typedefs ------------------------------------------------------------------
+  typedef PixelRowSpan<T, N>  RowSpan;
+  typedef typename std::conditional<std::is_const<T>::value,
+                                    const unsigned char, unsigned char>::type  BytePtrType;
+
+  // iterator class (iterates over rows) ---------------------------------------
+  class iterator
+  {
+  public:
+    iterator(BytePtrType *inPtr, ptrdiff_t inLineStep, unsigned int inWidth) :
+      mPtr(inPtr), mLineStep(inLineStep), mWidth(inWidth)
+    {
+    }
+    RowSpan operator*() const { return RowSpan((T *)mPtr, mWidth); }
+    iterator &operator++() { mPtr += mLineStep; return *this; }
+    bool operator!=(const iterator &inIt) const { return mPtr != inIt.mPtr; }
+    bool operator==(const iterator &inIt) const { return mPtr == inIt.mPtr; }
+
+  private:
+    BytePtrType   *mPtr;
+    ptrdiff_t     mLineStep;
+    unsigned int  mWidth;
+  };
+
+  // Constructors and Destructor -----------------------------------------------
+  PixelRange() :
+    mPtr(nullptr), mWidth(0), mHeight(0), mLineStep(0)
+  {
+  }
+  PixelRange(T *inPtr, unsigned int inWidth, unsigned int inHeight, ptrdiff_t inLineStep) :
+    mPtr((BytePtrType *)inPtr), mWidth(inWidth), mHeight(inHeight), mLineStep(inLineStep)
+  {
+  }
+  // Creates an empty range (isValid() == false) when the format can't be
+  // represented by this T and N (see isCompatible())
+  PixelRange(const ImageFormat &inFormat, T *inBufferPtr, unsigned int inPlaneIndex = 0) :
+    PixelRange()
+  {
+    if (inBufferPtr == nullptr || isCompatible(inFormat) == false ||
+        inPlaneIndex >= inFormat.planeNum())
+      return;
+    mPtr      = inFormat.linePtrFast(inBufferPtr, 0, inPlaneIndex);
+    mWidth    = inFormat.width();
+    mHeight   = inFormat.height();
+    mLineStep = inFormat.lineStride();    // Negative for bottom-up images
+  }
+
+  // Member functions ----------------------------------------------------------
+  bool isValid() const { return mPtr != nullptr && mWidth != 0 && mHeight != 0; }
+  unsigned int width() const { return mWidth; }
+  unsigned int height() const { return mHeight; }
+  ptrdiff_t lineStep() const { return mLineStep; }
+  T *linePtr(unsigned int inY) const
+  {
+    assert(inY < mHeight);
+    return (T *)(mPtr + mLineStep * (ptrdiff_t )inY);
+  }
+  RowSpan row(unsigned int inY) const
+  {
+    return RowSpan(linePtr(inY), mWidth);
+  }
+  PixelRange subRange(unsigned int inX, unsigned int inY,
+                      unsigned int inWidth, unsigned int inHeight) const
+  {
+    assert(inX + inWidth <= mWidth && inY + inHeight <= mHeight);
+    return PixelRange(linePtr(inY) + (size_t )inX * N, inWidth, inHeight, mLineStep);
+  }
+  iterator begin() const { return iterator(mPtr, mLineStep, mWidth); }
+  iterator end() const { return iterator(mPtr + mLineStep * (ptrdiff_t )mHeight, mLineStep, mWidth); }
+
+  // Static Functions ----------------------------------------------------------
+  static bool isCompatible(const ImageFormat &inFormat)
+  {
+    const ImageType &type = inFormat.type();
+    if (type.isPacked() || type.hasMacroPixelStructure())
+      return false;
+    if (type.sizeOfData() != sizeof(T))
+      return false;
+    if (type.isPlanar() == false && type.componentsPerPixel() != N)
+      return false;
+    if (type.isPlanar() && N != 1)
+      return false;
+    return inFormat.pixelStep() == sizeof(T) * N;
+  }
+
+private:
+  // Member variables ----------------------------------------------------------
+  BytePtrType   *mPtr;
+  unsigned int  mWidth;
+  unsigned int  mHeight;
+  ptrdiff_t     mLineStep;
+};
+
+// -----------------------------------------------------------------------------
+// transformRows
+// -----------------------------------------------------------------------------
+//  Calls inFunc(RowSpan inSrcRow, RowSpan outDstRow) for every row of the
+//  common area (for kernels that want to process a whole row at once)
+template <typename SrcT, unsigned int SrcN, typename DstT, unsigned int DstN, typename Func>
+inline void transformRows(const PixelRange<SrcT, SrcN> &inSrc,
+                          const PixelRange<DstT, DstN> &inDst, Func inFunc)
+{
+  unsigned int  width   = inSrc.width()  < inDst.width()  ? inSrc.width()  : inDst.width();
+  unsigned int  height  = inSrc.height() < inDst.height() ? inSrc.height() : inDst.height();
+
+  for (unsigned int y = 0; y < height; y++)
+    inFunc(PixelRowSpan<SrcT, SrcN>(inSrc.linePtr(y), width),
+           PixelRowSpan<DstT, DstN>(inDst.linePtr(y), width));
+}
+
+#endif //QIV_PIXEL_RANGE_H
@@ -0,0 +1,205 @@
+// =============================================================================
+//  RenderCache.cpp
+//
+//  Written in 2022 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     RenderCache.cpp
+  \author   Dairoku Sekiguchi
+  \version  1.0.0-pre_alpha.0
+  \date     2022/04/20
+*/
+
+// Includes --------------------------------------------------------------------
+#include "RenderCache.h"
+#include "ImageData.h"
+
+// -----------------------------------------------------------------------------
+// RenderCache
+// -----------------------------------------------------------------------------
+RenderCache::RenderCache(const RenderCacheKey &inKey) :
+  mKey(inKey),
+  mDisplayGeneration(0)
+{
+  ImageData::makeColorTable(mKey.colorMapIndex, mColorTable);
+  if (mKey.overlayFlag)
+    mScaler.setTargetFormat(QImage::Format_ARGB32_Premultiplied);
+  if (mKey.interimFlag)
+    mScaler.setFilterType(ImageScaler::FILTER_TYPE_NEAREST);
+  mScaler.setTransform(mKey.transform);
+}
+
+// -----------------------------------------------------------------------------
+// ~RenderCache
+// -----------------------------------------------------------------------------
+RenderCache::~RenderCache()
+{
+}
+
+// Member functions ------------------------------------------------------------
+// -----------------------------------------------------------------------------
+// getKey
+// -----------------------------------------------------------------------------
+const RenderCacheKey &RenderCache::getKey() const
+{
+  return mKey;
+}
+
+// -----------------------------------------------------------------------------
+// setVisibleRect
+// -----------------------------------------------------------------------------
+//  Every view that uses this cache tells its visible area, so that the cache
+//  covers all of them when they are close enough (see getCacheRect())
+void RenderCache::setVisibleRect(const void *inView, const QRect &inRect)
+{
+  mVisibleRectMap[inView] = inRect;
+}
+
+// -----------------------------------------------------------------------------
+// removeView
+// -----------------------------------------------------------------------------
+void RenderCache::removeView(const void *inView)
+{
+  mVisibleRectMap.erase(inView);
+}
+
+// -----------------------------------------------------------------------------
+// update
+// -----------------------------------------------------------------------------
+//  Makes sure that the pixmap covers inExposedRect of inView. When it doesn't
+//  (a view was scrolled), the pixmap is moved: the overlap is blitted
+//  (QPixmap::scroll() when the size is the same) and only the newly exposed
+//  strips are scaled
+bool RenderCache::update(const ImageData &inImageData, const void *inView,
+                         const QRect &inExposedRect, const QRect &inBoundRect)
+{
+  const QImage  *src = inImageData.getDisplayImage();
+  if (src == nullptr)
+    return false;
+  if (mDisplayGeneration != inImageData.getDisplayGeneration())
+  {
+    mDisplayGeneration = inImageData.getDisplayGeneration();
+    invalidate();
+    if (mKey.overlayFlag)
+    {
+      // The transparent color table of the overlay (see ImageData::setOverlayColor())
+      QVector<QRgb> table = src->colorTable();
+      for (int i = 0; i < 256; i++)
+        mColorTable[i] = i < table.size() ? qPremultiply(table[i]) : 0;
+    }
+  }
+  if (mRect.contains(inExposedRect))
+    return true;
+
+  QRect newRect = getCacheRect(inView, inExposedRect, inBoundRect);
+  if (newRect.isEmpty())
+    return false;
+
+  QRegion missingRegion(newRect);
+  QRect   overlapRect = newRect.intersected(mRect);
+  if (overlapRect.isEmpty())
+  {
+    if (mPixmap.size() != newRect.size())
+      mPixmap = makePixmap(newRect.size());
+  }
+  else if (mPixmap.size() == newRect.size())
+  {
+    QPoint  offset = mRect.topLeft() - newRect.topLeft();
+    mPixmap.scroll(offset.x(), offset.y(), mPixmap.rect());
+    missingRegion -= overlapRect;
+  }
+  else
+  {
+    QPixmap pixmap = makePixmap(newRect.size());
+    QPainter  painter(&pixmap);
+    painter.drawPixmap(overlapRect.topLeft() - newRect.topLeft(), mPixmap,
+                       overlapRect.translated(-mRect.topLeft()));
+    painter.end();
+    mPixmap = pixmap;
+    missingRegion -= overlapRect;
+  }
+  mRect = QRect();   // Invalid until all the strips are rendered
+
+  QPainter  painter(&mPixmap);
+  painter.setCompositionMode(QPainter::CompositionMode_Source);   // Replaces (overlays)
+  painter.translate(-newRect.topLeft());
+  for (const QRect &stripRect : missingRegion)
+    if (renderRect(*src, stripRect, painter) == false)
+      return false;
+  mRect = newRect;
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// draw
+// -----------------------------------------------------------------------------
+//  inExposedRect must be in the cache (update() returned true)
+void RenderCache::draw(QPainter &inPainter, const QRect &inExposedRect) const
+{
+  inPainter.drawPixmap(inExposedRect.topLeft(), mPixmap,
+                       inExposedRect.translated(-mRect.topLeft()));
+}
+
+// -----------------------------------------------------------------------------
+// invalidate
+// -----------------------------------------------------------------------------
+void RenderCache::invalidate()
+{
+  mRect = QRect();
+}
+
+// -----------------------------------------------------------------------------
+// getCacheRect
+// -----------------------------------------------------------------------------
+//  The visible areas of all the views + CACHE_MARGIN. When the views look at
+//  areas far apart (the union would be mostly unused), only inView is covered
+QRect RenderCache::getCacheRect(const void *inView, const QRect &inExposedRect,
+                                const QRect &inBoundRect) const
+{
+  QRect   viewRect = inExposedRect;
+  QRect   unionRect = inExposedRect;
+  qint64  areaSum = 0;
+  for (auto it = mVisibleRectMap.begin(); it != mVisibleRectMap.end(); it++)
+  {
+    QRect rect = it->second.intersected(inBoundRect);
+    if (it->first == inView)
+      viewRect = viewRect.united(rect);
+    unionRect = unionRect.united(rect);
+    areaSum += (qint64 )rect.width() * rect.height();
+  }
+  if ((qint64 )unionRect.width() * unionRect.height() > areaSum * SHARED_AREA_RATIO_MAX)
+    unionRect = viewRect;
+  unionRect = unionRect.adjusted(-CACHE_MARGIN, -CACHE_MARGIN, CACHE_MARGIN, CACHE_MARGIN);
+  return unionRect.intersected(inBoundRect);
+}
+
+// -----------------------------------------------------------------------------
+// makePixmap
+// -----------------------------------------------------------------------------
+//  The pixmap of an overlay has an alpha channel (filled with transparent)
+QPixmap RenderCache::makePixmap(const QSize &inSize) const
+{
+  QPixmap pixmap(inSize);
+  if (mKey.overlayFlag)
+    pixmap.fill(Qt::transparent);
+  return pixmap;
+}
+
+// -----------------------------------------------------------------------------
+// renderRect
+// -----------------------------------------------------------------------------
+//  inRect is in the view coordinates (inPainter is translated)
+bool RenderCache::renderRect(const QImage &inSrc, const QRect &inRect, QPainter &inPainter)
+{
+  if (mScaler.render(inSrc, mKey.zoomScale, inRect, &mRenderImage, mColorTable) == false)
+    return false;
+  inPainter.drawImage(inRect.topLeft(), mRenderImage);
+  return true;
+}
@@ -0,0 +1,103 @@
+// =============================================================================
+//  RenderCache.h
+//
+//  Written in 2022 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     RenderCache.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0-pre_alpha.0
+  \date     2022/04/20
+*/
+#ifndef QIV_RENDER_CACHE_H
+#define QIV_RENDER_CACHE_H
+
+// Includes --------------------------------------------------------------------
+#include <cstdint>
+#include <map>
+#include <QImage>
+#include <QPainter>
+#include <QPixmap>
+#include "ColorMap.h"
+#include "ImageScaler.h"
+
+class ImageData;
+
+// -----------------------------------------------------------------------------
+// RenderCacheKey struct
+// -----------------------------------------------------------------------------
+//  The view parameters that change the rendered pixels. Views with the same
+//  key share one RenderCache (see ImageData::acquireRenderCache())
+struct RenderCacheKey
+{
+  double  zoomScale;
+  ColorMap::ColorMapIndex colorMapIndex;  // CMI_NOT_SPECIFIED : grayscale
+  bool    interimFlag;                    // Nearest only (while zooming)
+  ImageScaler::Transform  transform;      // Flips (view transform)
+  bool    overlayFlag;                    // Transparent (the color table of the overlay)
+
+  bool operator==(const RenderCacheKey &inKey) const
+  {
+    return zoomScale == inKey.zoomScale && colorMapIndex == inKey.colorMapIndex &&
+           interimFlag == inKey.interimFlag && transform == inKey.transform &&
+           overlayFlag == inKey.overlayFlag;
+  }
+  bool operator!=(const RenderCacheKey &inKey) const
+  {
+    return !(*this == inKey);
+  }
+};
+
+// -----------------------------------------------------------------------------
+// RenderCache class
+// -----------------------------------------------------------------------------
+//  Screen-format pixmap of the scaled display image around the visible areas
+//  of its views (+ CACHE_MARGIN). It is made from the display image of the
+//  ImageData, which is converted once per frame for all the views, so a view
+//  only pays for the scaling of what it shows. The pixmap is moved by blits
+//  when the views scroll and made again when the display image is changed
+class RenderCache
+{
+public:
+  // Constants -----------------------------------------------------------------
+  const static int  CACHE_MARGIN = 256;       // Pixels rendered around the visible areas
+  const static int  SHARED_AREA_RATIO_MAX = 4; // Union of the views vs the sum of them
+
+  // Constructors and Destructor -----------------------------------------------
+  RenderCache(const RenderCacheKey &inKey);
+  virtual ~RenderCache();
+
+  // Member functions ----------------------------------------------------------
+  const RenderCacheKey &getKey() const;
+  void setVisibleRect(const void *inView, const QRect &inRect);
+  void removeView(const void *inView);
+  bool update(const ImageData &inImageData, const void *inView,
+              const QRect &inExposedRect, const QRect &inBoundRect);
+  void draw(QPainter &inPainter, const QRect &inExposedRect) const;
+  void invalidate();
+
+private:
+  // Member variables ----------------------------------------------------------
+  RenderCacheKey  mKey;
+  uint32_t    mColorTable[256];       // For the 8-bit display images (premultiplied for overlays)
+  ImageScaler mScaler;
+  QImage      mRenderImage;           // Scaled strip (reused)
+  QPixmap     mPixmap;
+  QRect       mRect;                  // Area of mPixmap in the view (empty : invalid)
+  unsigned int  mDisplayGeneration;   // ImageData::getDisplayGeneration() of mPixmap
+  std::map<const void *, QRect> mVisibleRectMap;
+
+  // Member functions ----------------------------------------------------------
+  QRect getCacheRect(const void *inView, const QRect &inExposedRect, const QRect &inBoundRect) const;
+  QPixmap makePixmap(const QSize &inSize) const;
+  bool  renderRect(const QImage &inSrc, const QRect &inRect, QPainter &inPainter);
+};
+
+#endif //QIV_RENDER_CACHE_H
@@ -20,17 +20,29 @@
 #define QIB_VIEW_DATA_INTERFACE_H
 
 // Includes --------------------------------------------------------------------
+#include <cstdint>
 #include <vector>
+#include <QRect>
+
+class ImageData;
 
 // -----------------------------------------------------------------------------
 // ViewDataInterface interface class
 // -----------------------------------------------------------------------------
+//  ImageData calls these in the GUI thread only (requests from the other
+//  threads are queued and merged by its FramePresenter)
 class ViewDataInterface
 {
 public:
   // Member functions ----------------------------------------------------------
-  virtual void    updateWidget()   = 0;
+  // inDirtyRect (image coordinates) of inImageData was changed since the last
+  // call, its display now shows the frame of inFrameGeneration
+  virtual void    updateWidget(const ImageData *inImageData, const QRect &inDirtyRect,
+                               uint64_t inFrameGeneration)   = 0;
   virtual void    setImageSizeChangedFlag(bool inFlag)   = 0;
+  // The image area (image coordinates) the view shows or may show soon, its
+  // dirty tiles are converted before the others. Empty when hidden
+  virtual QRect   getVisibleImageRect() const   = 0;
 };
 
 #endif //QIB_VIEW_DATA_INTERFACE_H
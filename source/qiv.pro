@@ -1,4 +1,4 @@
-QT += core gui widgets
+QT += core gui widgets concurrent
 
 TARGET = qiv
 TEMPLATE = app
@@ -7,22 +7,34 @@ DESTDIR = ./output
 CONFIG += c++17
 # Before Qt 5.11 we need the following too
 unix:QMAKE_CXXFLAGS += -std=c++17
+# The built-in colormap tables are generated at compile time (ColorMap.cpp)
+# and need more constexpr evaluation steps than the clang / MSVC defaults
+clang:QMAKE_CXXFLAGS += -fconstexpr-steps=16777216
+msvc:QMAKE_CXXFLAGS += /constexpr:steps16777216
 
 INCLUDEPATH += .
 
 HEADERS += \
     ColorMap.h  \
+    ConstexprMath.h \
+    FramePresenter.h \
     ImageFormat.h \
     ImageType.h \
     ImageWindow.h \
     ViewDataInterface.h \
     ImageData.h \
+    ImageScaler.h \
     ImageScrollArea.h \
     ImageView.h \
+    PixelKernels.h \
+    PixelRange.h \
+    RenderCache.h \
     MainWindow.h
 
 SOURCES += \
     ColorMap.cpp  \
+    FramePresenter.cpp \
+    ImageScaler.cpp \
     ImageScrollArea.cpp \
     ImageWindow.cpp \
     ImageData.cpp \
@@ -30,6 +42,8 @@ SOURCES += \
     main.cpp  \
     ImageFormat.cpp \
     ImageView.cpp \
+    PixelKernels.cpp \
+    RenderCache.cpp \
     MainWindow.cpp
 
 FORMS += \